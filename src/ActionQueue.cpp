@@ -0,0 +1,163 @@
+#include "ActionQueue.h"
+#include <string.h>
+
+void ActionQueue::begin(BleComboAbs* combo, Scheduler* sched)
+{
+  hid = combo;
+  scheduler = sched;
+  timer = scheduler->create(onTimer, this);
+  count = 0;
+}
+
+void ActionQueue::onTimer(void* arg)
+{
+  ActionQueue* queue = (ActionQueue*)arg;
+  queue->run(millis());
+}
+
+void ActionQueue::push(uint32_t time, ActionType type, const KeyReport* report, int16_t x, int16_t y)
+{
+  Action& a = actions[count++];
+  a.time = time;
+  a.type = type;
+  if (report != nullptr) {
+    a.report = *report;
+  } else {
+    memset(&a.report, 0, sizeof(KeyReport));
+  }
+  a.x = x;
+  a.y = y;
+}
+
+// A key tapped again before its release went out would merge both taps into one
+// keystroke. The pending release is brought forward instead (but stays behind a
+// press still waiting for it) and the new press follows one tick later.
+uint32_t ActionQueue::retapTime(const KeyReport& report, uint32_t now)
+{
+  int8_t lastRelease = -1;
+  bool pressPending = false;
+  uint32_t lastPress = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    if (memcmp(&actions[i].report, &report, sizeof(KeyReport)) != 0) {
+      continue;
+    }
+    if (actions[i].type == ACTION_KEY_PRESS) {
+      if (!pressPending || (int32_t)(actions[i].time - lastPress) > 0) {
+        lastPress = actions[i].time;
+      }
+      pressPending = true;
+    } else if (actions[i].type == ACTION_KEY_RELEASE) {
+      if (lastRelease < 0 || (int32_t)(actions[i].time - actions[lastRelease].time) > 0) {
+        lastRelease = i;
+      }
+    }
+  }
+  if (lastRelease < 0) {
+    return now;
+  }
+  uint32_t releaseAt = pressPending ? lastPress + ACTION_RETAP_GAP_MS : now;
+  if ((int32_t)(actions[lastRelease].time - releaseAt) > 0) {
+    actions[lastRelease].time = releaseAt;
+  }
+  return actions[lastRelease].time + ACTION_RETAP_GAP_MS;
+}
+
+// Press and release are queued together or not at all, so a full queue never leaves a key stuck.
+// The press goes out with the report of the current tick, the release from the timer.
+bool ActionQueue::tapKey(const KeyReport& report, uint32_t now, uint16_t holdMs)
+{
+  if (count + 2 > ACTION_QUEUE_SIZE) {
+    dropped++;
+    return false;
+  }
+  uint32_t pressAt = retapTime(report, now);
+  push(pressAt, ACTION_KEY_PRESS, &report, 0, 0);
+  push(pressAt + holdMs, ACTION_KEY_RELEASE, &report, 0, 0);
+  run(now);
+  return true;
+}
+
+bool ActionQueue::clickAbs(int16_t x, int16_t y, uint32_t now, uint16_t holdMs)
+{
+  if (count + 2 > ACTION_QUEUE_SIZE) {
+    dropped++;
+    return false;
+  }
+  push(now, ACTION_ABS_MOVE, nullptr, x, y);
+  push(now + holdMs, ACTION_ABS_RELEASE, nullptr, 0, 0);
+  run(now);
+  return true;
+}
+
+void ActionQueue::execute(const Action& action, uint8_t index)
+{
+  switch (action.type) {
+    case ACTION_KEY_PRESS:
+      hid->pressReport(action.report);
+      break;
+    case ACTION_KEY_RELEASE:
+      // Taps of the same key never overlap, retapTime() orders them
+      hid->releaseReport(action.report);
+      break;
+    case ACTION_ABS_MOVE:
+      hid->moveAbs(action.x, action.y);
+      break;
+    case ACTION_ABS_RELEASE:
+      // Overlapping clicks: only the last release lifts the pointer
+      for (uint8_t i = 0; i < count; i++) {
+        if (i != index && actions[i].type == ACTION_ABS_RELEASE) {
+          return;
+        }
+      }
+      hid->releaseAbs();
+      break;
+  }
+}
+
+// Sends all due events, earliest first and in insertion order for equal times
+void ActionQueue::run(uint32_t now)
+{
+  while (count > 0) {
+    int8_t next = -1;
+    for (uint8_t i = 0; i < count; i++) {
+      if ((int32_t)(now - actions[i].time) >= 0 && (next < 0 || (int32_t)(actions[i].time - actions[next].time) < 0)) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      break;
+    }
+    Action action = actions[next];
+    execute(action, next);
+    for (uint8_t i = next; i + 1 < count; i++) {
+      actions[i] = actions[i + 1];
+    }
+    count--;
+  }
+  rearm();
+}
+
+void ActionQueue::rearm(void)
+{
+  if (count == 0) {
+    scheduler->stop(timer);
+    return;
+  }
+  uint32_t earliest = actions[0].time;
+  for (uint8_t i = 1; i < count; i++) {
+    if ((int32_t)(actions[i].time - earliest) < 0) {
+      earliest = actions[i].time;
+    }
+  }
+  scheduler->arm(timer, earliest);
+}
+
+uint8_t ActionQueue::pending(void)
+{
+  return count;
+}
+
+uint32_t ActionQueue::droppedActions(void)
+{
+  return dropped;
+}
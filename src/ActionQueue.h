@@ -0,0 +1,55 @@
+#ifndef ACTION_QUEUE_H
+#define ACTION_QUEUE_H
+
+#include <Arduino.h>
+#include "BleComboAbs.h"
+#include "Scheduler.h"
+
+#define ACTION_QUEUE_SIZE 32
+#define ACTION_RETAP_GAP_MS 1 // one loop tick, so release and re-press go out as separate reports
+
+enum ActionType : uint8_t
+{
+  ACTION_KEY_PRESS,
+  ACTION_KEY_RELEASE,
+  ACTION_ABS_MOVE,
+  ACTION_ABS_RELEASE
+};
+
+// Timed HID report events. A tap becomes a press now and a release after the
+// hold time; both are sent from a scheduler timer, so loop() never waits.
+class ActionQueue
+{
+private:
+  typedef struct
+  {
+    uint32_t time;
+    ActionType type;
+    KeyReport report;
+    int16_t x;
+    int16_t y;
+  } Action;
+
+  BleComboAbs* hid = nullptr;
+  Scheduler* scheduler = nullptr;
+  TimerId timer = SCHEDULER_NO_TIMER;
+  Action actions[ACTION_QUEUE_SIZE]; // kept in insertion order
+  uint8_t count = 0;
+  uint32_t dropped = 0;
+
+  void push(uint32_t time, ActionType type, const KeyReport* report, int16_t x, int16_t y);
+  uint32_t retapTime(const KeyReport& report, uint32_t now);
+  void execute(const Action& action, uint8_t index);
+  void rearm(void);
+  static void onTimer(void* arg);
+
+public:
+  void begin(BleComboAbs* hid, Scheduler* scheduler);
+  bool tapKey(const KeyReport& report, uint32_t now, uint16_t holdMs);
+  bool clickAbs(int16_t x, int16_t y, uint32_t now, uint16_t holdMs);
+  void run(uint32_t now);
+  uint8_t pending(void);
+  uint32_t droppedActions(void);
+};
+
+#endif // ACTION_QUEUE_H
@@ -0,0 +1,75 @@
+#include "ActionReplay.h"
+
+void ActionReplay::removeFirst(void)
+{
+  for (uint8_t i = 0; i + 1 < count; i++) {
+    entries[i] = entries[i + 1];
+  }
+  count--;
+}
+
+// Drops expired entries from the front; later entries may be older than a
+// short-lived one before them, those go when they reach the front
+void ActionReplay::expire(uint32_t now)
+{
+  while (count > 0 && now - entries[0].time > entries[0].ttl) {
+    removeFirst();
+    stats.expired++;
+  }
+}
+
+// Keeps the action for replay, false if its policy does not keep actions
+bool ActionReplay::push(int16_t action, const ReplayPolicy& policy, uint32_t now)
+{
+  if (action == ACTION_NONE || policy.ttl == 0) {
+    return false;
+  }
+  if (policy.coalesce && count > 0 && entries[count - 1].action == action) {
+    // Same result as the one already waiting: only its lifetime starts again
+    entries[count - 1].time = now;
+    stats.coalesced++;
+    return true;
+  }
+  expire(now);
+  if (count >= REPLAY_BUFFER_SIZE) {
+    removeFirst();
+    stats.dropped++;
+  }
+  Entry& e = entries[count++];
+  e.action = action;
+  e.ttl = policy.ttl;
+  e.time = now;
+  stats.buffered++;
+  return true;
+}
+
+// Oldest action still within its TTL, ACTION_NONE when nothing is left
+int16_t ActionReplay::next(uint32_t now)
+{
+  while (count > 0) {
+    Entry e = entries[0];
+    removeFirst();
+    if (now - e.time > e.ttl) {
+      stats.expired++;
+      continue;
+    }
+    stats.replayed++;
+    return e.action;
+  }
+  return ACTION_NONE;
+}
+
+void ActionReplay::clear(void)
+{
+  count = 0;
+}
+
+uint8_t ActionReplay::pending(void)
+{
+  return count;
+}
+
+const ReplayStats& ActionReplay::getStats(void)
+{
+  return stats;
+}
@@ -0,0 +1,49 @@
+#ifndef ACTION_REPLAY_H
+#define ACTION_REPLAY_H
+
+#include <Arduino.h>
+#include "ActionTable.h"
+
+#define REPLAY_BUFFER_SIZE 16
+#define REPLAY_DEFAULT_TTL_MS 3000
+#define REPLAY_START_DELAY_MS 300 // host needs a moment to re-enable notifications
+#define REPLAY_GAP_MS 20          // pause after each replayed action's hold time
+
+typedef struct
+{
+  uint32_t buffered;
+  uint32_t coalesced;
+  uint32_t replayed;
+  uint32_t expired;
+  uint32_t dropped;
+} ReplayStats;
+
+// Actions triggered while the link is down, kept in trigger order until the
+// host is back. Each entry expires after the TTL of its action; next() skips
+// expired ones. A full buffer drops the oldest entry.
+class ActionReplay
+{
+private:
+  typedef struct
+  {
+    int16_t action;
+    uint16_t ttl;
+    uint32_t time;
+  } Entry;
+
+  Entry entries[REPLAY_BUFFER_SIZE]; // kept in insertion order
+  uint8_t count = 0;
+  ReplayStats stats = {};
+
+  void removeFirst(void);
+  void expire(uint32_t now);
+
+public:
+  bool push(int16_t action, const ReplayPolicy& policy, uint32_t now);
+  int16_t next(uint32_t now);
+  void clear(void);
+  uint8_t pending(void);
+  const ReplayStats& getStats(void);
+};
+
+#endif // ACTION_REPLAY_H
@@ -0,0 +1,125 @@
+#include "ActionTable.h"
+#include <string.h>
+
+void ActionTable::clear(void)
+{
+  count = 0;
+}
+
+int16_t ActionTable::find(const String& name, const ActionRecord& record)
+{
+  for (uint8_t i = 0; i < count; i++) {
+    if (memcmp(&records[i], &record, sizeof(ActionRecord)) == 0 && names[i] == name) {
+      return i;
+    }
+  }
+  return ACTION_NONE;
+}
+
+int16_t ActionTable::add(const String& name, const ActionRecord& record)
+{
+  int16_t id = find(name, record);
+  if (id != ACTION_NONE) {
+    return id;
+  }
+  if (count >= ACTION_TABLE_SIZE) {
+    return ACTION_NONE;
+  }
+  records[count] = record;
+  names[count] = name;
+  return count++;
+}
+
+int16_t ActionTable::addKey(const String& name, const KeyReport& report, uint16_t hold, const ReplayPolicy& replay)
+{
+  ActionRecord record;
+  memset(&record, 0, sizeof(ActionRecord));
+  record.kind = ACTION_KIND_KEY;
+  record.hold = hold;
+  record.report = report;
+  record.replay = replay;
+  return add(name, record);
+}
+
+int16_t ActionTable::addAbsTap(const String& name, int x, int y, uint16_t hold, const ReplayPolicy& replay)
+{
+  ActionRecord record;
+  memset(&record, 0, sizeof(ActionRecord));
+  record.kind = ACTION_KIND_ABS_TAP;
+  record.hold = hold;
+  record.x = (int16_t)constrain(x, 0, 10000);
+  record.y = (int16_t)constrain(y, 0, 10000);
+  record.replay = replay;
+  return add(name, record);
+}
+
+int16_t ActionTable::addMacro(const String& name, int8_t macro, const ReplayPolicy& replay)
+{
+  ActionRecord record;
+  memset(&record, 0, sizeof(ActionRecord));
+  record.kind = ACTION_KIND_MACRO;
+  record.x = macro;
+  record.replay = replay;
+  return add(name, record);
+}
+
+int16_t ActionTable::addMacroStop(const String& name, const ReplayPolicy& replay)
+{
+  ActionRecord record;
+  memset(&record, 0, sizeof(ActionRecord));
+  record.kind = ACTION_KIND_MACRO_STOP;
+  record.replay = replay;
+  return add(name, record);
+}
+
+int16_t ActionTable::addTouch(const String& name, int8_t gesture, const ReplayPolicy& replay)
+{
+  ActionRecord record;
+  memset(&record, 0, sizeof(ActionRecord));
+  record.kind = ACTION_KIND_TOUCH;
+  record.x = gesture;
+  record.replay = replay;
+  return add(name, record);
+}
+
+uint8_t ActionTable::size(void)
+{
+  return count;
+}
+
+const ActionRecord& ActionTable::get(int16_t id)
+{
+  return records[id];
+}
+
+const String& ActionTable::name(int16_t id)
+{
+  return names[id];
+}
+
+// Hands the action to the queue, the macro engine or the touch gestures, false if the ID is invalid
+// or there is no room left
+bool ActionTable::dispatch(int16_t id, ActionQueue& queue, MacroEngine& macros, TouchGestures& touch, uint32_t now)
+{
+  if (id < 0 || id >= count) {
+    return false;
+  }
+  const ActionRecord& record = records[id];
+  switch (record.kind) {
+    case ACTION_KIND_KEY:
+      return queue.tapKey(record.report, now, record.hold);
+    case ACTION_KIND_ABS_TAP:
+      return queue.clickAbs(record.x, record.y, now, record.hold);
+    case ACTION_KIND_MACRO:
+      if (macros.isRunning(record.x)) {
+        return macros.cancel(record.x);
+      }
+      return macros.start(record.x, now);
+    case ACTION_KIND_MACRO_STOP:
+      macros.cancelAll();
+      return true;
+    case ACTION_KIND_TOUCH:
+      return touch.start(record.x, now);
+  }
+  return false;
+}
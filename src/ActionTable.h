@@ -0,0 +1,67 @@
+#ifndef ACTION_TABLE_H
+#define ACTION_TABLE_H
+
+#include <Arduino.h>
+#include "BleComboAbs.h"
+#include "ActionQueue.h"
+#include "MacroEngine.h"
+#include "TouchGestures.h"
+
+#define ACTION_TABLE_SIZE 96
+#define ACTION_NONE -1
+
+enum ActionKind : uint8_t
+{
+  ACTION_KIND_KEY,
+  ACTION_KIND_ABS_TAP,
+  ACTION_KIND_MACRO,     // starts the macro, a second trigger cancels it
+  ACTION_KIND_MACRO_STOP, // cancels all running macros
+  ACTION_KIND_TOUCH       // plays a touch gesture
+};
+
+// What happens to an action triggered while the link is down: kept for ttl ms
+// (0 = dropped) and replayed after the reconnect; with coalesce, a repeat of the
+// newest kept action only refreshes it
+typedef struct
+{
+  uint16_t ttl;
+  bool coalesce;
+} ReplayPolicy;
+
+// Action resolved at load time: everything the dispatch needs, nothing to look up
+typedef struct
+{
+  ActionKind kind;
+  uint16_t hold;
+  int16_t x; // ACTION_KIND_ABS_TAP, already clamped to 0..10000; macro or gesture index
+  int16_t y;
+  KeyReport report; // ACTION_KIND_KEY
+  ReplayPolicy replay;
+} ActionRecord;
+
+// Table of the configured actions, addressed by integer ID. Equal actions share
+// one entry. Names are kept for log output only.
+class ActionTable
+{
+private:
+  ActionRecord records[ACTION_TABLE_SIZE];
+  String names[ACTION_TABLE_SIZE];
+  uint8_t count = 0;
+
+  int16_t find(const String& name, const ActionRecord& record);
+  int16_t add(const String& name, const ActionRecord& record);
+
+public:
+  void clear(void);
+  int16_t addKey(const String& name, const KeyReport& report, uint16_t hold, const ReplayPolicy& replay);
+  int16_t addAbsTap(const String& name, int x, int y, uint16_t hold, const ReplayPolicy& replay);
+  int16_t addMacro(const String& name, int8_t macro, const ReplayPolicy& replay);
+  int16_t addMacroStop(const String& name, const ReplayPolicy& replay);
+  int16_t addTouch(const String& name, int8_t gesture, const ReplayPolicy& replay);
+  uint8_t size(void);
+  const ActionRecord& get(int16_t id);
+  const String& name(int16_t id);
+  bool dispatch(int16_t id, ActionQueue& queue, MacroEngine& macros, TouchGestures& touch, uint32_t now);
+};
+
+#endif // ACTION_TABLE_H
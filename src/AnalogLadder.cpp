@@ -0,0 +1,98 @@
+#include "AnalogLadder.h"
+
+bool AnalogLadder::begin(int adcPin, const uint16_t* levelsMv, uint8_t keys, uint16_t idleMv, uint8_t confirm)
+{
+  if (adcPin < 0 || keys == 0 || keys > LADDER_MAX_KEYS) {
+    return false;
+  }
+  // Sort the key levels together with the idle level (at most 9 entries,
+  // insertion sort). Idle may lie above the keys (pull-up ladder), below them
+  // (pull-down ladder) or between two of them; it classifies as LADDER_NONE.
+  uint16_t sorted[LADDER_MAX_KEYS + 1];
+  int8_t order[LADDER_MAX_KEYS + 1];
+  for (uint8_t i = 0; i <= keys; i++) {
+    uint16_t mv = i < keys ? levelsMv[i] : idleMv;
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > mv) {
+      sorted[j] = sorted[j - 1];
+      order[j] = order[j - 1];
+      j--;
+    }
+    sorted[j] = mv;
+    order[j] = i < keys ? (int8_t)i : LADDER_NONE;
+  }
+  for (uint8_t i = 1; i <= keys; i++) {
+    if (sorted[i] == sorted[i - 1] && (order[i] == LADDER_NONE || order[i - 1] == LADDER_NONE)) {
+      return false; // a key at the idle voltage could never be detected
+    }
+  }
+  pin = adcPin;
+  count = keys;
+  confirmSamples = confirm > 0 ? confirm : 1;
+  // Thresholds halfway between neighbouring levels, the highest level takes everything above
+  for (uint8_t i = 0; i <= count; i++) {
+    keyOf[i] = order[i];
+    upperMv[i] = (i < count) ? (uint16_t)((sorted[i] + sorted[i + 1]) / 2) : UINT16_MAX;
+  }
+
+  analogSetPinAttenuation(pin, ADC_11db);
+  adcAttachPin(pin);
+  candidate = LADDER_NONE;
+  agree = 0;
+  current = LADDER_NONE;
+  return true;
+}
+
+bool AnalogLadder::isConfigured(void)
+{
+  return count > 0;
+}
+
+uint8_t AnalogLadder::keyCount(void)
+{
+  return count;
+}
+
+int8_t AnalogLadder::classify(uint16_t mv)
+{
+  for (uint8_t i = 0; i < count; i++) {
+    if (mv < upperMv[i]) {
+      return keyOf[i];
+    }
+  }
+  return keyOf[count];
+}
+
+// Takes one ADC sample. A new key is only accepted after `confirmSamples`
+// consecutive samples agree, which rejects the intermediate voltages while the
+// contact settles. Returns true when the pressed key changed.
+bool AnalogLadder::sample(int8_t& key)
+{
+  if (count == 0) {
+    return false;
+  }
+  lastMv = (uint16_t)analogReadMilliVolts(pin);
+  int8_t k = classify(lastMv);
+  if (k != candidate) {
+    candidate = k;
+    agree = 1;
+  } else if (agree < confirmSamples) {
+    agree++;
+  }
+  if (agree >= confirmSamples && candidate != current) {
+    current = candidate;
+    key = current;
+    return true;
+  }
+  return false;
+}
+
+int8_t AnalogLadder::pressedKey(void)
+{
+  return current;
+}
+
+uint16_t AnalogLadder::lastMilliVolts(void)
+{
+  return lastMv;
+}
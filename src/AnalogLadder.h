@@ -0,0 +1,37 @@
+#ifndef ANALOG_LADDER_H
+#define ANALOG_LADDER_H
+
+#include <Arduino.h>
+
+#define LADDER_MAX_KEYS 8
+#define LADDER_NONE -1
+
+// Several buttons on one ADC pin through a resistor ladder. Each button pulls the
+// pin to its own voltage; the thresholds between neighbouring voltages are
+// computed once, so classifying a sample is a short table walk. Only one button
+// of a ladder can be detected at a time. The idle voltage can lie above the
+// levels (pull-up) or below them (pull-down).
+class AnalogLadder
+{
+private:
+  int pin = -1;
+  uint8_t count = 0;
+  uint16_t upperMv[LADDER_MAX_KEYS + 1]; // sorted, sample below upperMv[i] belongs to keyOf[i]
+  int8_t keyOf[LADDER_MAX_KEYS + 1];      // key index, LADDER_NONE for the idle level
+  uint8_t confirmSamples = 3;
+  int8_t candidate = LADDER_NONE;
+  uint8_t agree = 0;
+  int8_t current = LADDER_NONE;
+  uint16_t lastMv = 0;
+
+public:
+  bool begin(int pin, const uint16_t* levelsMv, uint8_t count, uint16_t idleMv, uint8_t confirm);
+  bool isConfigured(void);
+  uint8_t keyCount(void);
+  int8_t classify(uint16_t mv);
+  bool sample(int8_t& key);
+  int8_t pressedKey(void);
+  uint16_t lastMilliVolts(void);
+};
+
+#endif // ANALOG_LADDER_H
@@ -1,175 +1,255 @@
 #include "BleComboAbs.h"
 
-#if defined(CONFIG_BT_ENABLED)
-
-#if defined(USE_NIMBLE)
-#include <NimBLEDevice.h>
-#include <NimBLEServer.h>
-#include <NimBLEUtils.h>
-#include <NimBLEHIDDevice.h>
-#else
-#include <BLEDevice.h>
-#include <BLEUtils.h>
-#include <BLEServer.h>
-#include "BLE2902.h"
-#include "BLEHIDDevice.h"
-#endif // USE_NIMBLE
-
-#include "HIDTypes.h"
+#include "HidDescriptor.h"
 #include <Arduino.h>
-#include <driver/adc.h>
-#include "sdkconfig.h"
-
-#if defined(CONFIG_ARDUHAL_ESP_LOG)
-  #include "esp32-hal-log.h"
-  #define LOG_TAG ""
-#else
-  #include "esp_log.h"
-  static const char* LOG_TAG = "BLEDevice";
-#endif
-
-#define KEYBOARD_ID 0x01
-#define ABS_MOUSE_ID 0x02
+#include <string.h>
+#include <esp_timer.h>
 
 #define LSB(v) ((v >> 8) & 0xff)
 #define MSB(v) (v & 0xff)
 
-static const uint8_t _hidReportDescriptor[] = {
-  USAGE_PAGE(1),      0x01,          // USAGE_PAGE (Generic Desktop Ctrls)
-  USAGE(1),           0x06,          // USAGE (Keyboard)
-  COLLECTION(1),      0x01,          // COLLECTION (Application)
-  REPORT_ID(1),       KEYBOARD_ID,   //   REPORT_ID (1)
-  USAGE_PAGE(1),      0x07,          //   USAGE_PAGE (Kbrd/Keypad)
-  USAGE_MINIMUM(1),   0xE0,          //   USAGE_MINIMUM (0xE0)
-  USAGE_MAXIMUM(1),   0xE7,          //   USAGE_MAXIMUM (0xE7)
-  LOGICAL_MINIMUM(1), 0x00,          //   LOGICAL_MINIMUM (0)
-  LOGICAL_MAXIMUM(1), 0x01,          //   LOGICAL_MAXIMUM (1)
-  REPORT_SIZE(1),     0x01,          //   REPORT_SIZE (1)
-  REPORT_COUNT(1),    0x08,          //   REPORT_COUNT (8)
-  HIDINPUT(1),        0x02,          //   INPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-  REPORT_COUNT(1),    0x01,          //   REPORT_COUNT (1) ; 1 byte (Reserved)
-  REPORT_SIZE(1),     0x08,          //   REPORT_SIZE (8)
-  HIDINPUT(1),        0x01,          //   INPUT (Const,Array,Abs,No Wrap,Linear,Preferred State,No Null Position)
-  REPORT_COUNT(1),    0x05,          //   REPORT_COUNT (5) ; 5 bits (Num lock, Caps lock, Scroll lock, Compose, Kana)
-  REPORT_SIZE(1),     0x01,          //   REPORT_SIZE (1)
-  USAGE_PAGE(1),      0x08,          //   USAGE_PAGE (LEDs)
-  USAGE_MINIMUM(1),   0x01,          //   USAGE_MINIMUM (0x01) ; Num Lock
-  USAGE_MAXIMUM(1),   0x05,          //   USAGE_MAXIMUM (0x05) ; Kana
-  HIDOUTPUT(1),       0x02,          //   OUTPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-  REPORT_COUNT(1),    0x01,          //   REPORT_COUNT (1) ; 3 bits (Padding)
-  REPORT_SIZE(1),     0x03,          //   REPORT_SIZE (3)
-  HIDOUTPUT(1),       0x01,          //   OUTPUT (Const,Array,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-  REPORT_COUNT(1),    0x06,          //   REPORT_COUNT (6) ; 6 bytes (Keys)
-  REPORT_SIZE(1),     0x08,          //   REPORT_SIZE (8)
-  LOGICAL_MINIMUM(1), 0x00,          //   LOGICAL_MINIMUM (0)
-  LOGICAL_MAXIMUM(1), 0x65,          //   LOGICAL_MAXIMUM(0x65) ; 101 keys
-  USAGE_PAGE(1),      0x07,          //   USAGE_PAGE (Kbrd/Keypad)
-  USAGE_MINIMUM(1),   0x00,          //   USAGE_MINIMUM (0)
-  USAGE_MAXIMUM(1),   0x65,          //   USAGE_MAXIMUM (0x65)
-  HIDINPUT(1),        0x00,          //   INPUT (Data,Array,Abs,No Wrap,Linear,Preferred State,No Null Position)
-  END_COLLECTION(0),                 // END_COLLECTION
-
-  // Absolute mouse (digitizer)
-  0x05, 0x0d,                    // USAGE_PAGE (Digitizer)
-  0x09, 0x04,                    // USAGE (Touch Screen)
-  0xa1, 0x01,                    // COLLECTION (Application)
-  0x85, ABS_MOUSE_ID,            //   REPORT_ID
-  0x09, 0x20,                    //   Usage (Stylus)
-  0xA1, 0x00,                    //   Collection (Physical)
-  0x09, 0x42,                    //     Usage (Tip Switch)
-  0x09, 0x32,                    //     USAGE (In Range)
-  0x15, 0x00,                    //     LOGICAL_MINIMUM (0)
-  0x25, 0x01,                    //     LOGICAL_MAXIMUM (1)
-  0x75, 0x01,                    //     REPORT_SIZE (1)
-  0x95, 0x02,                    //     REPORT_COUNT (2)
-  0x81, 0x02,                    //     INPUT (Data,Var,Abs)
-  0x75, 0x01,                    //     REPORT_SIZE (1)
-  0x95, 0x06,                    //     REPORT_COUNT (6)
-  0x81, 0x01,                    //     INPUT (Cnst,Ary,Abs)
-  0x05, 0x01,                    //     Usage Page (Generic Desktop)
-  0x09, 0x01,                    //     Usage (Pointer)
-  0xA1, 0x00,                    //     Collection (Physical)
-  0x09, 0x30,                    //        Usage (X)
-  0x09, 0x31,                    //        Usage (Y)
-  0x16, 0x00, 0x00,              //        Logical Minimum (0)
-  0x26, 0x10, 0x27,              //        Logical Maximum (10000)
-  0x36, 0x00, 0x00,              //        Physical Minimum (0)
-  0x46, 0x10, 0x27,              //        Physical Maximum (10000)
-  0x66, 0x00, 0x00,              //        UNIT (None)
-  0x75, 0x10,                    //        Report Size (16)
-  0x95, 0x02,                    //        Report Count (2)
-  0x81, 0x02,                    //        Input (Data,Var,Abs)
-  0xc0,                          //     END_COLLECTION
-  0xc0,                          //   END_COLLECTION
-  0xc0                           // END_COLLECTION
+using namespace hid;
+
+// Report descriptor, composed at compile time. Report IDs follow the order in HidDevice.
+struct KeyboardCollection
+{
+  template <uint8_t Id>
+  static constexpr auto build()
+  {
+    return usagePage<0x01>() + usage<0x06>() + collection<APPLICATION>() + // Generic Desktop, Keyboard
+           reportId<Id>() +
+           usagePage<0x07>() + usageMin<0xE0>() + usageMax<0xE7>() +      // modifiers
+           logicalMin<0>() + logicalMax<1>() + reportSize<1>() + reportCount<8>() +
+           input<DATA_VAR_ABS>() +
+           reportCount<1>() + reportSize<8>() + input<CONSTANT>() +        // reserved byte
+           reportCount<5>() + reportSize<1>() +                            // LEDs: Num Lock .. Kana
+           usagePage<0x08>() + usageMin<0x01>() + usageMax<0x05>() +
+           output<DATA_VAR_ABS>() +
+           reportCount<1>() + reportSize<3>() + output<CONSTANT>() +       // LED padding
+           reportCount<6>() + reportSize<8>() +                            // 6 key slots
+           logicalMin<0>() + logicalMax<0x65>() +
+           usagePage<0x07>() + usageMin<0x00>() + usageMax<0x65>() +
+           input<DATA_ARRAY_ABS>() +
+           endCollection();
+  }
 };
 
-BleComboAbs::BleComboAbs(std::string deviceName, std::string deviceManufacturer, uint8_t batteryLevel)
-    : hid(0)
-    , deviceName(std::string(deviceName).substr(0, 15))
-    , deviceManufacturer(std::string(deviceManufacturer).substr(0, 15))
-    , batteryLevel(batteryLevel) {}
+// Single-point absolute mouse (digitizer stylus), coordinates 0..10000
+struct AbsMouseCollection
+{
+  template <uint8_t Id>
+  static constexpr auto build()
+  {
+    return usagePage<0x0D>() + usage<0x04>() + collection<APPLICATION>() + // Digitizer, Touch Screen
+           reportId<Id>() +
+           usage<0x20>() + collection<PHYSICAL>() +                        // Stylus
+           usage<0x42>() + usage<0x32>() +                                 // Tip Switch, In Range
+           logicalMin<0>() + logicalMax<1>() + reportSize<1>() + reportCount<2>() +
+           input<DATA_VAR_ABS>() +
+           reportSize<1>() + reportCount<6>() + input<CONSTANT>() +
+           usagePage<0x01>() + usage<0x01>() + collection<PHYSICAL>() +   // Generic Desktop, Pointer
+           usage<0x30>() + usage<0x31>() +                                 // X, Y
+           logicalMin<0>() + logicalMax<10000>() +
+           physicalMin<0>() + physicalMax<10000>() + unit<0>() +
+           reportSize<16>() + reportCount<2>() + input<DATA_VAR_ABS>() +
+           endCollection() +
+           endCollection() +
+           endCollection();
+  }
+};
 
-void BleComboAbs::begin(void)
+// N-key-rollover keyboard, used instead of the keyboard report when enabled
+struct NkroCollection
 {
-  BLEDevice::init(deviceName);
-  BLEServer* pServer = BLEDevice::createServer();
-  pServer->setCallbacks(this);
+  template <uint8_t Id>
+  static constexpr auto build()
+  {
+    return usagePage<0x01>() + usage<0x06>() + collection<APPLICATION>() +
+           reportId<Id>() +
+           usagePage<0x07>() + usageMin<0xE0>() + usageMax<0xE7>() +      // modifiers
+           logicalMin<0>() + logicalMax<1>() + reportSize<1>() + reportCount<8>() +
+           input<DATA_VAR_ABS>() +
+           usageMin<0x00>() + usageMax<NKRO_KEY_COUNT - 1>() +            // one bit per key
+           reportSize<1>() + reportCount<NKRO_KEY_COUNT>() +
+           input<DATA_VAR_ABS>() +
+           endCollection();
+  }
+};
 
-  hid = new BLEHIDDevice(pServer);
-  inputKeyboard = hid->inputReport(KEYBOARD_ID);
-  outputKeyboard = hid->outputReport(KEYBOARD_ID);
-  inputAbsMouse = hid->inputReport(ABS_MOUSE_ID);
+// Gamepad: every button one bit, the whole pad state in one report
+struct GamepadCollection
+{
+  template <uint8_t Id>
+  static constexpr auto build()
+  {
+    return usagePage<0x01>() + usage<0x05>() + collection<APPLICATION>() + // Generic Desktop, Game Pad
+           reportId<Id>() +
+           usagePage<0x09>() + usageMin<1>() + usageMax<GAMEPAD_BUTTON_COUNT>() +
+           logicalMin<0>() + logicalMax<1>() +
+           reportSize<1>() + reportCount<GAMEPAD_BUTTON_COUNT>() +
+           input<DATA_VAR_ABS>() +
+           usagePage<0x01>() + usage<0x39>() +                             // Hat switch
+           logicalMin<0>() + logicalMax<7>() +
+           physicalMin<0>() + physicalMax<315>() + unit<0x14>() +          // degrees
+           reportSize<4>() + reportCount<1>() +
+           input<DATA_VAR_ABS_NULL>() +
+           unit<0>() + reportSize<4>() + input<CONSTANT>() +              // padding
+           endCollection();
+  }
+};
 
-  outputKeyboard->setCallbacks(this);
+// Multi-touch screen, two fingers for pinch gestures
+struct TouchCollection
+{
+  static constexpr auto finger()
+  {
+    return usage<0x22>() + collection<LOGICAL>() +                        // Finger
+           usage<0x42>() +                                                 // Tip Switch
+           logicalMin<0>() + logicalMax<1>() + reportSize<1>() + reportCount<1>() +
+           input<DATA_VAR_ABS>() +
+           reportSize<7>() + input<CONSTANT>() +
+           usage<0x51>() + logicalMax<TOUCH_MAX_CONTACTS - 1>() +          // Contact Identifier
+           reportSize<8>() + input<DATA_VAR_ABS>() +
+           usagePage<0x01>() + usage<0x30>() + usage<0x31>() +             // X, Y
+           logicalMax<10000>() + physicalMax<10000>() +
+           reportSize<16>() + reportCount<2>() + input<DATA_VAR_ABS>() +
+           usagePage<0x0D>() + physicalMin<0>() + physicalMax<0>() +
+           endCollection();
+  }
+
+  template <uint8_t Id>
+  static constexpr auto build()
+  {
+    return usagePage<0x0D>() + usage<0x04>() + collection<APPLICATION>() + // Digitizer, Touch Screen
+           reportId<Id>() +
+           finger() + finger() +
+           usage<0x54>() +                                                 // Contact Count
+           logicalMin<0>() + logicalMax<TOUCH_MAX_CONTACTS>() +
+           reportSize<8>() + reportCount<1>() + input<DATA_VAR_ABS>() +
+           usage<0x55>() + feature<DATA_VAR_ABS>() +                      // Contact Count Maximum
+           endCollection();
+  }
+};
 
-  hid->manufacturer()->setValue(deviceManufacturer);
-  hid->pnp(0x02, 0x05ac, 0x820a, 0x0210);
-  hid->hidInfo(0x00, 0x01);
+// New report types are added here, IDs and the descriptor follow automatically
+typedef Descriptor<KeyboardCollection, AbsMouseCollection, NkroCollection, GamepadCollection, TouchCollection> HidDevice;
 
-#if defined(USE_NIMBLE)
-  BLEDevice::setSecurityAuth(true, true, true);
-#else
-  BLESecurity* pSecurity = new BLESecurity();
-  pSecurity->setAuthenticationMode(ESP_LE_AUTH_REQ_SC_MITM_BOND);
-#endif // USE_NIMBLE
+static constexpr auto _hidReportDescriptor = HidDevice::bytes();
+static constexpr uint8_t KEYBOARD_ID = HidDevice::id<KeyboardCollection>();
+static constexpr uint8_t ABS_MOUSE_ID = HidDevice::id<AbsMouseCollection>();
+static constexpr uint8_t NKRO_ID = HidDevice::id<NkroCollection>();
+static constexpr uint8_t GAMEPAD_ID = HidDevice::id<GamepadCollection>();
+static constexpr uint8_t TOUCH_ID = HidDevice::id<TouchCollection>();
 
-  hid->reportMap((uint8_t*)_hidReportDescriptor, sizeof(_hidReportDescriptor));
-  hid->startServices();
+static_assert(reportBytes(_hidReportDescriptor, TAG_INPUT, KEYBOARD_ID) == sizeof(KeyReport), "keyboard report size");
+static_assert(reportBytes(_hidReportDescriptor, TAG_OUTPUT, KEYBOARD_ID) == 1, "LED report size");
+static_assert(reportBytes(_hidReportDescriptor, TAG_INPUT, ABS_MOUSE_ID) == ABS_MOUSE_REPORT_LEN, "abs mouse report size");
+static_assert(reportBytes(_hidReportDescriptor, TAG_INPUT, NKRO_ID) == sizeof(NkroReport), "NKRO report size");
+static_assert(reportBytes(_hidReportDescriptor, TAG_INPUT, GAMEPAD_ID) == sizeof(GamepadReport), "gamepad report size");
+static_assert(reportBytes(_hidReportDescriptor, TAG_INPUT, TOUCH_ID) == sizeof(TouchReport), "touch report size");
+static_assert(reportBytes(_hidReportDescriptor, TAG_FEATURE, TOUCH_ID) == 1, "touch feature report size");
+// Hosts cache the descriptor when bonding, so a change in layout leaves bonded
+// hosts decoding with the old one. These pin the wire format; changing them means
+// bonded hosts have to pair again.
+static_assert(_hidReportDescriptor.size == 346, "descriptor length changed");
+static_assert(KEYBOARD_ID == 1 && ABS_MOUSE_ID == 2 && NKRO_ID == 3 && GAMEPAD_ID == 4 && TOUCH_ID == 5, "report IDs changed");
+static_assert(reportBytes(_hidReportDescriptor, TAG_INPUT, KEYBOARD_ID) == 8 &&
+              reportBytes(_hidReportDescriptor, TAG_OUTPUT, KEYBOARD_ID) == 1 &&
+              reportBytes(_hidReportDescriptor, TAG_INPUT, ABS_MOUSE_ID) == 5 &&
+              reportBytes(_hidReportDescriptor, TAG_INPUT, NKRO_ID) == 14 &&
+              reportBytes(_hidReportDescriptor, TAG_INPUT, GAMEPAD_ID) == 5 &&
+              reportBytes(_hidReportDescriptor, TAG_INPUT, TOUCH_ID) == 13 &&
+              reportBytes(_hidReportDescriptor, TAG_FEATURE, TOUCH_ID) == 1, "report size changed");
+static_assert(sizeof(NkroReport) <= HID_REPORT_MAX_LEN && sizeof(TouchReport) <= HID_REPORT_MAX_LEN, "report queue slot too small");
 
-  onStarted(pServer);
+BleComboAbs::BleComboAbs(std::string deviceName, std::string deviceManufacturer, uint8_t batteryLevel)
+#if defined(CONFIG_BT_ENABLED)
+    : nimble(deviceName, deviceManufacturer, batteryLevel)
+    , transport(&nimble)
+#endif
+{
+}
 
-  advertising = pServer->getAdvertising();
-  advertising->setAppearance(HID_KEYBOARD);
-  advertising->addServiceUUID(hid->hidService()->getUUID());
-  advertising->addServiceUUID(BLEUUID((uint16_t)0x180F));
-  advertising->setScanResponse(false);
-  advertising->start();
-  hid->setBatteryLevel(batteryLevel);
+// Replaces the NimBLE link, e.g. with a loopback for measurements; call before begin()
+void BleComboAbs::setTransport(HidTransport* t)
+{
+  transport = t;
+}
 
-  ESP_LOGD(LOG_TAG, "Advertising started!");
+void BleComboAbs::begin(void)
+{
+  if (transport == nullptr) {
+    return;
+  }
+  transport->addReport(HID_REPORT_INPUT, KEYBOARD_ID);
+  transport->addReport(HID_REPORT_OUTPUT, KEYBOARD_ID);
+  transport->addReport(HID_REPORT_INPUT, ABS_MOUSE_ID);
+  transport->addReport(HID_REPORT_INPUT, NKRO_ID);
+  transport->addReport(HID_REPORT_INPUT, GAMEPAD_ID);
+  transport->addReport(HID_REPORT_INPUT, TOUCH_ID);
+  uint8_t maxContacts = TOUCH_MAX_CONTACTS;
+  transport->addReport(HID_REPORT_FEATURE, TOUCH_ID, &maxContacts, 1);
+  if (linkRequested) {
+    transport->requestLinkParams(linkRequest);
+  }
+  transport->begin(_hidReportDescriptor.data, sizeof(_hidReportDescriptor.data), this);
 }
 
 void BleComboAbs::end(void)
 {
+  if (transport != nullptr) {
+    transport->end();
+  }
 }
 
 bool BleComboAbs::isConnected(void)
 {
-  return this->connected;
+  return this->connected.load(std::memory_order_relaxed);
 }
 
 void BleComboAbs::setBatteryLevel(uint8_t level)
 {
-  this->batteryLevel = level;
-  if (hid != 0) {
-    this->hid->setBatteryLevel(this->batteryLevel);
+  if (transport != nullptr) {
+    transport->setBatteryLevel(level);
   }
 }
 
 void BleComboAbs::setName(std::string deviceName)
 {
-  this->deviceName = deviceName;
+#if defined(CONFIG_BT_ENABLED)
+  nimble.setName(deviceName);
+#endif
+}
+
+void BleComboAbs::setAdvertising(const AdvertisingPolicy& policy)
+{
+#if defined(CONFIG_BT_ENABLED)
+  nimble.setAdvertising(policy);
+#endif
+}
+
+// Connection parameters to ask for after every connect; call before begin()
+void BleComboAbs::setLinkProfile(const HidLinkParams& params)
+{
+  linkRequest = params;
+  linkRequested = true;
+}
+
+// Named link profiles: "race" for the lowest latency, "endurance" to let the
+// radio sleep through most connection events. False for unknown names.
+bool BleComboAbs::parseLinkProfile(const char* name, HidLinkParams& params)
+{
+  if (strcmp(name, "race") == 0) {
+    // 7.5 .. 11.25 ms, every event; 2 s timeout is the shortest some hosts accept
+    params = {6, 9, 0, 200};
+    return true;
+  }
+  if (strcmp(name, "endurance") == 0) {
+    // 100 .. 150 ms, up to 10 events skipped while idle (1.65 s between wakeups)
+    params = {80, 120, 10, 600};
+    return true;
+  }
+  return false;
 }
 
 void BleComboAbs::setDelay(uint32_t ms)
@@ -182,15 +262,290 @@ void BleComboAbs::setDebug(bool enabled)
   this->debugEnabled = enabled;
 }
 
+void BleComboAbs::setNkro(bool enabled)
+{
+  this->nkro = enabled;
+}
+
+bool BleComboAbs::isNkro(void)
+{
+  return this->nkro;
+}
+
+uint8_t BleComboAbs::pendingReports(void)
+{
+  return reportCount;
+}
+
+const ReportStats& BleComboAbs::getReportStats(void)
+{
+  reportStats.connIntervalUs = connIntervalUs;
+  return reportStats;
+}
+
+const LinkStats& BleComboAbs::getLinkStats(void)
+{
+  linkStats.updates = linkUpdates.load(std::memory_order_acquire);
+  linkStats.intervalUs = connIntervalUs;
+  linkStats.latency = linkLatency.load(std::memory_order_relaxed);
+  linkStats.timeoutMs = linkTimeoutMs.load(std::memory_order_relaxed);
+  return linkStats;
+}
+
+const ReconnectStats& BleComboAbs::getReconnectStats(void)
+{
+  reconnectStats.disconnects = disconnectCount.load(std::memory_order_relaxed);
+  return reconnectStats;
+}
+
+void BleComboAbs::queueReport(uint8_t id, const uint8_t* data, uint8_t length)
+{
+  if (reportCount >= HID_REPORT_QUEUE_SIZE) {
+    // Drop the oldest report not yet handed to the stack, later reports carry the newer state
+    uint8_t drop = notifyResult.load(std::memory_order_acquire) == NOTIFY_IDLE ? 0 : 1;
+    for (uint8_t i = drop; i + 1 < reportCount; i++) {
+      reports[i] = reports[i + 1];
+    }
+    reportCount--;
+    reportStats.dropped++;
+  }
+  PendingReport& r = reports[reportCount++];
+  r.id = id;
+  r.length = length;
+  memcpy(r.data, data, length);
+  r.enqueuedUs = esp_timer_get_time();
+}
+
+// True if the pending key state holds a key or modifier that has not been reported yet
+bool BleComboAbs::hasNewKeys(void)
+{
+  if (_keyReport.modifiers & ~_sentKeyReport.modifiers) {
+    return true;
+  }
+  for (uint8_t i = 0; i < 6; i++) {
+    uint8_t k = _keyReport.keys[i];
+    if (k != 0 && _sentKeyReport.keys[0] != k && _sentKeyReport.keys[1] != k &&
+        _sentKeyReport.keys[2] != k && _sentKeyReport.keys[3] != k &&
+        _sentKeyReport.keys[4] != k && _sentKeyReport.keys[5] != k) {
+      return true;
+    }
+  }
+  for (uint8_t i = 0; i < sizeof(_nkroKeys); i++) {
+    if (_nkroKeys[i] & ~_sentNkroKeys[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// True if the key was released since the last report; pressing it again in the
+// same tick has to report the release first or both taps merge into one
+bool BleComboAbs::releasedUnsent(uint8_t modifiers, uint8_t k)
+{
+  if (modifiers & _sentKeyReport.modifiers & ~_keyReport.modifiers) {
+    return true;
+  }
+  if (k == 0) {
+    return false;
+  }
+  if (nkro && k < NKRO_KEY_COUNT) {
+    uint8_t bit = (uint8_t)(1 << (k & 0x7));
+    return (_sentNkroKeys[k >> 3] & bit) && !(_nkroKeys[k >> 3] & bit);
+  }
+  bool sent = false;
+  bool pending = false;
+  for (uint8_t i = 0; i < 6; i++) {
+    sent |= _sentKeyReport.keys[i] == k;
+    pending |= _keyReport.keys[i] == k;
+  }
+  return sent && !pending;
+}
+
+void BleComboAbs::flushKeys(void)
+{
+  if (!keysDirty) {
+    return;
+  }
+  if (nkro) {
+    NkroReport report;
+    report.modifiers = _keyReport.modifiers;
+    memcpy(report.keys, _nkroKeys, sizeof(report.keys));
+    if (this->isConnected()) {
+      queueReport(NKRO_ID, (const uint8_t*)&report, sizeof(NkroReport));
+    }
+    memcpy(_sentNkroKeys, _nkroKeys, sizeof(_nkroKeys));
+    // Usages beyond the bitmap still go through the 6KRO report, modifiers only once
+    if (memcmp(_keyReport.keys, _sentKeyReport.keys, sizeof(_keyReport.keys)) != 0) {
+      KeyReport overflow = _keyReport;
+      overflow.modifiers = 0;
+      sendKeyboardReport(&overflow);
+    }
+  } else {
+    sendKeyboardReport(&_keyReport);
+  }
+  _sentKeyReport = _keyReport;
+  keysDirty = false;
+}
+
+void BleComboAbs::flushAbs(void)
+{
+  if (!absDirty) {
+    return;
+  }
+  sendAbsMouseReport(absState, absX, absY);
+  absDirty = false;
+}
+
+void BleComboAbs::flushGamepad(void)
+{
+  if (!gamepadDirty) {
+    return;
+  }
+  if (memcmp(&_gamepad, &_sentGamepad, sizeof(GamepadReport)) != 0 && this->isConnected()) {
+    queueReport(GAMEPAD_ID, (const uint8_t*)&_gamepad, sizeof(GamepadReport));
+  }
+  _sentGamepad = _gamepad;
+  gamepadDirty = false;
+}
+
+void BleComboAbs::flushTouch(void)
+{
+  if (!touchDirty) {
+    return;
+  }
+  // Lifted fingers are reported once more with the tip cleared
+  _touch.count = 0;
+  for (uint8_t c = 0; c < TOUCH_MAX_CONTACTS; c++) {
+    if (_touch.contacts[c].tip || _sentTouch.contacts[c].tip) {
+      _touch.count++;
+    }
+  }
+  if (this->isConnected()) {
+    queueReport(TOUCH_ID, (const uint8_t*)&_touch, sizeof(TouchReport));
+  }
+  _sentTouch = _touch;
+  touchDirty = false;
+}
+
+// Turns all changes since the last call into at most one report per collection
+// (plus the intermediate ones needed for taps and clicks)
+void BleComboAbs::flush(void)
+{
+  flushKeys();
+  flushAbs();
+  flushGamepad();
+  flushTouch();
+}
+
+// Sends queued reports as fast as the link takes them: one report at a time,
+// the next as soon as the transport reports the previous one accepted. If the controller
+// has no buffer left, the report is retried after one connection interval.
+void BleComboAbs::update(void)
+{
+  flush();
+  while (reportCount > 0) {
+    int64_t now = esp_timer_get_time();
+    if (!this->isConnected()) {
+      reportCount = 0;
+      notifyResult.store(NOTIFY_IDLE, std::memory_order_relaxed);
+      return;
+    }
+    if (notifyResult.load(std::memory_order_acquire) != NOTIFY_IDLE) {
+      finishNotify(now);
+      if (notifyResult.load(std::memory_order_acquire) != NOTIFY_IDLE) {
+        return;
+      }
+      continue;
+    }
+    if (now < nextSendUs) {
+      return;
+    }
+    PendingReport& r = reports[0];
+    notifyStartUs = now;
+    notifyResult.store(NOTIFY_OUTSTANDING, std::memory_order_release);
+    transport->send(r.id, r.data, r.length);
+  }
+}
+
+void BleComboAbs::finishNotify(int64_t now)
+{
+  uint8_t result = notifyResult.load(std::memory_order_acquire);
+  if (result == NOTIFY_OUTSTANDING) {
+    // No status within two connection intervals: count it as sent and go on
+    if (now - notifyStartUs < 2 * (int64_t)connIntervalUs) {
+      return;
+    }
+    notifyDoneUs.store((uint32_t)now, std::memory_order_relaxed);
+    result = NOTIFY_DONE;
+  }
+  if (result == NOTIFY_RETRY) {
+    reportStats.retries++;
+    nextSendUs = now + connIntervalUs;
+    notifyResult.store(NOTIFY_IDLE, std::memory_order_relaxed);
+    return;
+  }
+  if (result == NOTIFY_DONE) {
+    uint32_t latency = notifyDoneUs.load(std::memory_order_relaxed) - (uint32_t)reports[0].enqueuedUs;
+    reportStats.sent++;
+    reportStats.lastUs = latency;
+    reportStats.totalUs += latency;
+    if (latency > reportStats.maxUs) {
+      reportStats.maxUs = latency;
+    }
+    if (debugEnabled) {
+      Serial.print("[DEBUG] Report gesendet nach ");
+      Serial.print(latency);
+      Serial.println(" us");
+    }
+    if (awaitingFirstReport.load(std::memory_order_acquire)) {
+      awaitingFirstReport.store(false, std::memory_order_relaxed);
+      uint32_t lost = disconnectMs.load(std::memory_order_relaxed);
+      reconnectStats.lastConnectMs = connectMs.load(std::memory_order_relaxed) - lost;
+      reconnectStats.lastFirstReportMs = (uint32_t)(now / 1000) - lost;
+      if (reconnectStats.lastFirstReportMs > reconnectStats.maxFirstReportMs) {
+        reconnectStats.maxFirstReportMs = reconnectStats.lastFirstReportMs;
+      }
+      if (debugEnabled) {
+        Serial.print("[DEBUG] Wiederverbunden nach ");
+        Serial.print(reconnectStats.lastConnectMs);
+        Serial.print(" ms, erster Report nach ");
+        Serial.print(reconnectStats.lastFirstReportMs);
+        Serial.println(" ms");
+      }
+    }
+  } else {
+    reportStats.failed++;
+  }
+  for (uint8_t i = 0; i + 1 < reportCount; i++) {
+    reports[i] = reports[i + 1];
+  }
+  reportCount--;
+  nextSendUs = now + (int64_t)_delay_ms * 1000;
+  notifyResult.store(NOTIFY_IDLE, std::memory_order_relaxed);
+}
+
+// Milliseconds until update() has something to do, UINT32_MAX if the queue is empty
+uint32_t BleComboAbs::msUntilReady(void)
+{
+  if (reportCount == 0) {
+    return UINT32_MAX;
+  }
+  int64_t now = esp_timer_get_time();
+  int64_t due = nextSendUs;
+  if (notifyResult.load(std::memory_order_acquire) == NOTIFY_OUTSTANDING) {
+    // onSendComplete() wakes the loop earlier
+    due = notifyStartUs + 2 * (int64_t)connIntervalUs;
+  }
+  if (due <= now) {
+    return 0;
+  }
+  return (uint32_t)((due - now + 999) / 1000);
+}
+
 void BleComboAbs::sendKeyboardReport(KeyReport* keys)
 {
   if (this->isConnected()) {
-    ESP_LOGD(LOG_TAG, "[DEBUG] Keyboard report sent");
-    this->inputKeyboard->setValue((uint8_t*)keys, sizeof(KeyReport));
-    this->inputKeyboard->notify();
-#if defined(USE_NIMBLE)
-    this->delay_ms(_delay_ms);
-#endif
+    queueReport(KEYBOARD_ID, (const uint8_t*)keys, sizeof(KeyReport));
   }
 }
 
@@ -205,17 +560,13 @@ void BleComboAbs::sendAbsMouseReport(uint8_t state, int16_t x, int16_t y)
       Serial.print(" y=");
       Serial.println(y);
     }
-    uint8_t m[5];
+    uint8_t m[ABS_MOUSE_REPORT_LEN];
     m[0] = state;
     m[1] = MSB(x);
     m[2] = LSB(x);
     m[3] = MSB(y);
     m[4] = LSB(y);
-    this->inputAbsMouse->setValue(m, 5);
-    this->inputAbsMouse->notify();
-#if defined(USE_NIMBLE)
-    this->delay_ms(_delay_ms);
-#endif
+    queueReport(ABS_MOUSE_ID, m, ABS_MOUSE_REPORT_LEN);
   } else if (debugEnabled) {
     Serial.println("[DEBUG] Abs mouse report skipped (not connected)");
   }
@@ -359,24 +710,29 @@ const uint8_t _asciimap[128] =
 
 uint8_t USBPutChar(uint8_t c);
 
-size_t BleComboAbs::press(uint8_t k)
+uint8_t BleComboAbs::usageFromAscii(uint8_t c, uint8_t* modifiers)
+{
+  if (c >= 128) {
+    return 0;
+  }
+  uint8_t k = pgm_read_byte(_asciimap + c);
+  if (k & SHIFT) {
+    *modifiers |= 0x02;
+    k &= 0x7F;
+  }
+  return k;
+}
+
+// Adds a key usage to the pending state: one bit in NKRO mode, a free slot otherwise
+bool BleComboAbs::addUsage(uint8_t k)
 {
   uint8_t i;
-  if (k >= 136) {
-    k = k - 136;
-  } else if (k >= 128) {
-    _keyReport.modifiers |= (1 << (k - 128));
-    k = 0;
-  } else {
-    k = pgm_read_byte(_asciimap + k);
-    if (!k) {
-      setWriteError();
-      return 0;
-    }
-    if (k & SHIFT) {
-      _keyReport.modifiers |= 0x02;
-      k &= 0x7F;
+  if (nkro && k < NKRO_KEY_COUNT) {
+    if (k != 0) {
+      _nkroKeys[k >> 3] |= (uint8_t)(1 << (k & 0x7));
     }
+    keysDirty = true;
+    return true;
   }
 
   if (_keyReport.keys[0] != k && _keyReport.keys[1] != k &&
@@ -390,45 +746,124 @@ size_t BleComboAbs::press(uint8_t k)
       }
     }
     if (i == 6) {
+      return false;
+    }
+  }
+  keysDirty = true;
+  return true;
+}
+
+void BleComboAbs::removeUsage(uint8_t k)
+{
+  if (nkro && k < NKRO_KEY_COUNT) {
+    if (k != 0) {
+      _nkroKeys[k >> 3] &= (uint8_t)~(1 << (k & 0x7));
+    }
+  } else {
+    for (uint8_t i = 0; i < 6; i++) {
+      if (0 != k && _keyReport.keys[i] == k) {
+        _keyReport.keys[i] = 0x00;
+      }
+    }
+  }
+  keysDirty = true;
+}
+
+size_t BleComboAbs::press(uint8_t k)
+{
+  uint8_t modifiers = 0;
+  if (k >= 136) {
+    k = k - 136;
+  } else if (k >= 128) {
+    modifiers = (uint8_t)(1 << (k - 128));
+    k = 0;
+  } else {
+    k = usageFromAscii(k, &modifiers);
+    if (!k) {
       setWriteError();
       return 0;
     }
   }
-  sendKeyboardReport(&_keyReport);
+
+  if (keysDirty && releasedUnsent(modifiers, k)) {
+    flushKeys();
+  }
+  _keyReport.modifiers |= modifiers;
+  if (!addUsage(k)) {
+    setWriteError();
+    return 0;
+  }
   return 1;
 }
 
 size_t BleComboAbs::release(uint8_t k)
 {
-  uint8_t i;
+  // A key pressed and released within one tick still needs its own report
+  if (keysDirty && hasNewKeys()) {
+    flushKeys();
+  }
   if (k >= 136) {
     k = k - 136;
   } else if (k >= 128) {
     _keyReport.modifiers &= ~(1 << (k - 128));
     k = 0;
   } else {
-    k = pgm_read_byte(_asciimap + k);
+    uint8_t modifiers = 0;
+    k = usageFromAscii(k, &modifiers);
     if (!k) {
       return 0;
     }
-    if (k & SHIFT) {
-      _keyReport.modifiers &= ~(0x02);
-      k &= 0x7F;
-    }
+    _keyReport.modifiers &= ~modifiers;
   }
 
-  for (i = 0; i < 6; i++) {
-    if (0 != k && _keyReport.keys[i] == k) {
-      _keyReport.keys[i] = 0x00;
+  removeUsage(k);
+  return 1;
+}
+
+// Presses a precompiled report (see KeyExpression): modifiers and up to six usages
+size_t BleComboAbs::pressReport(const KeyReport& report)
+{
+  if (keysDirty) {
+    bool released = releasedUnsent(report.modifiers, 0);
+    for (uint8_t i = 0; i < 6 && !released; i++) {
+      released = releasedUnsent(0, report.keys[i]);
+    }
+    if (released) {
+      flushKeys();
     }
   }
+  _keyReport.modifiers |= report.modifiers;
+  keysDirty = true;
+  size_t n = 1;
+  for (uint8_t i = 0; i < 6; i++) {
+    if (report.keys[i] != 0 && !addUsage(report.keys[i])) {
+      setWriteError();
+      n = 0;
+    }
+  }
+  return n;
+}
 
-  sendKeyboardReport(&_keyReport);
+size_t BleComboAbs::releaseReport(const KeyReport& report)
+{
+  if (keysDirty && hasNewKeys()) {
+    flushKeys();
+  }
+  _keyReport.modifiers &= ~report.modifiers;
+  keysDirty = true;
+  for (uint8_t i = 0; i < 6; i++) {
+    if (report.keys[i] != 0) {
+      removeUsage(report.keys[i]);
+    }
+  }
   return 1;
 }
 
 void BleComboAbs::releaseAll(void)
 {
+  if (keysDirty && hasNewKeys()) {
+    flushKeys();
+  }
   _keyReport.keys[0] = 0;
   _keyReport.keys[1] = 0;
   _keyReport.keys[2] = 0;
@@ -436,7 +871,8 @@ void BleComboAbs::releaseAll(void)
   _keyReport.keys[4] = 0;
   _keyReport.keys[5] = 0;
   _keyReport.modifiers = 0;
-  sendKeyboardReport(&_keyReport);
+  memset(_nkroKeys, 0, sizeof(_nkroKeys));
+  keysDirty = true;
 }
 
 size_t BleComboAbs::write(uint8_t c)
@@ -470,67 +906,137 @@ void BleComboAbs::clickAbs(int16_t x, int16_t y)
 
 void BleComboAbs::moveAbs(int16_t x, int16_t y)
 {
-  sendAbsMouseReport(3, x, y);
+  setAbs(3, x, y);
   absPressed = true;
 }
 
 void BleComboAbs::releaseAbs(void)
 {
-  sendAbsMouseReport(0, 0, 0);
+  setAbs(0, 0, 0);
   absPressed = false;
 }
 
+// Moves within one tick collapse to the last position; a tip down/up change
+// keeps the previous state as its own report so no click gets lost
+void BleComboAbs::setAbs(uint8_t state, int16_t x, int16_t y)
+{
+  if (absDirty && state != absState) {
+    flushAbs();
+  }
+  absState = state;
+  absX = x;
+  absY = y;
+  absDirty = true;
+}
+
 bool BleComboAbs::isAbsPressed(void)
 {
   return absPressed;
 }
 
-void BleComboAbs::onConnect(BLEServer* pServer)
+// A button released in the same tick it was pressed still gets its own report
+void BleComboAbs::setGamepadButton(uint8_t index, bool pressed)
 {
-  this->connected = true;
+  if (index >= GAMEPAD_BUTTON_COUNT) {
+    return;
+  }
+  uint8_t bit = (uint8_t)(1 << (index & 0x7));
+  uint8_t& byte = _gamepad.buttons[index >> 3];
+  if (pressed) {
+    byte |= bit;
+  } else {
+    if ((byte & bit) && !(_sentGamepad.buttons[index >> 3] & bit)) {
+      flushGamepad();
+    }
+    byte &= (uint8_t)~bit;
+  }
+  gamepadDirty = true;
+}
 
-  if (hid != 0) {
-    hid->setBatteryLevel(batteryLevel);
+// Moves of a finger within one tick collapse to the last position; a finger
+// that touches down and lifts within one tick still gets its own report
+void BleComboAbs::setTouch(uint8_t contact, bool down, int16_t x, int16_t y)
+{
+  if (contact >= TOUCH_MAX_CONTACTS) {
+    return;
+  }
+  TouchContact& c = _touch.contacts[contact];
+  if (touchDirty && c.tip != _sentTouch.contacts[contact].tip && c.tip != (uint8_t)down) {
+    flushTouch();
   }
+  c.tip = down ? 1 : 0;
+  c.id = contact;
+  c.x[0] = MSB(x);
+  c.x[1] = LSB(x);
+  c.y[0] = MSB(y);
+  c.y[1] = LSB(y);
+  touchDirty = true;
+}
 
-#if !defined(USE_NIMBLE)
-  BLE2902* desc = (BLE2902*)this->inputKeyboard->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-  desc->setNotifications(true);
-  desc = (BLE2902*)this->inputAbsMouse->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-  desc->setNotifications(true);
-#endif
+void BleComboAbs::releaseTouch(void)
+{
+  for (uint8_t c = 0; c < TOUCH_MAX_CONTACTS; c++) {
+    if (touchDirty && _touch.contacts[c].tip && !_sentTouch.contacts[c].tip) {
+      flushTouch();
+    }
+  }
+  for (uint8_t c = 0; c < TOUCH_MAX_CONTACTS; c++) {
+    if (_touch.contacts[c].tip) {
+      _touch.contacts[c].tip = 0;
+      touchDirty = true;
+    }
+  }
 }
 
-void BleComboAbs::onDisconnect(BLEServer* pServer)
+void BleComboAbs::setGamepadHat(uint8_t hat)
 {
-  this->connected = false;
+  if (hat > GAMEPAD_HAT_CENTER) {
+    hat = GAMEPAD_HAT_CENTER;
+  }
+  if (gamepadDirty && _gamepad.hat != _sentGamepad.hat && _gamepad.hat != hat) {
+    flushGamepad();
+  }
+  _gamepad.hat = hat;
+  gamepadDirty = true;
+}
 
-#if !defined(USE_NIMBLE)
-  BLE2902* desc = (BLE2902*)this->inputKeyboard->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-  desc->setNotifications(false);
-  desc = (BLE2902*)this->inputAbsMouse->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-  desc->setNotifications(false);
-  advertising->start();
-#endif
+void BleComboAbs::onTransportConnect(void)
+{
+  connectMs.store((uint32_t)(esp_timer_get_time() / 1000), std::memory_order_relaxed);
+  if (disconnectCount.load(std::memory_order_relaxed) > 0) {
+    awaitingFirstReport.store(true, std::memory_order_release);
+  }
+  this->connected.store(true, std::memory_order_relaxed);
 }
 
-void BleComboAbs::onWrite(BLECharacteristic* me)
+void BleComboAbs::onTransportDisconnect(void)
 {
-  uint8_t* value = (uint8_t*)(me->getValue().c_str());
-  (void)value;
-  ESP_LOGI(LOG_TAG, "keyboard LED update: %d", *value);
+  this->connected.store(false, std::memory_order_relaxed);
+  awaitingFirstReport.store(false, std::memory_order_relaxed);
+  disconnectMs.store((uint32_t)(esp_timer_get_time() / 1000), std::memory_order_relaxed);
+  disconnectCount.store(disconnectCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 }
 
-void BleComboAbs::delay_ms(uint64_t ms)
+void BleComboAbs::onLinkParams(uint32_t intervalUs, uint16_t latency, uint32_t timeoutMs)
 {
-  uint64_t m = esp_timer_get_time();
-  if (ms) {
-    uint64_t e = (m + (ms * 1000));
-    if (m > e) {
-      while (esp_timer_get_time() > e) { }
-    }
-    while (esp_timer_get_time() < e) { }
-  }
+  connIntervalUs = intervalUs;
+  linkLatency.store(latency, std::memory_order_relaxed);
+  linkTimeoutMs.store(timeoutMs, std::memory_order_relaxed);
+  linkUpdates.store(linkUpdates.load(std::memory_order_relaxed) + 1, std::memory_order_release);
 }
 
-#endif // CONFIG_BT_ENABLED
+// Completion of the outstanding report, possibly from the transport's own task
+void BleComboAbs::onSendComplete(HidSendResult result)
+{
+  if (notifyResult.load(std::memory_order_acquire) != NOTIFY_OUTSTANDING) {
+    return;
+  }
+  uint8_t state = NOTIFY_FAILED;
+  if (result == HID_SEND_DONE) {
+    state = NOTIFY_DONE;
+  } else if (result == HID_SEND_RETRY) {
+    state = NOTIFY_RETRY;
+  }
+  notifyDoneUs.store((uint32_t)esp_timer_get_time(), std::memory_order_relaxed);
+  notifyResult.store(state, std::memory_order_release);
+}
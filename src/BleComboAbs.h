@@ -2,26 +2,21 @@
 #define BLE_COMBO_ABS_H
 
 #include "sdkconfig.h"
-#if defined(CONFIG_BT_ENABLED)
-
-#if defined(USE_NIMBLE)
-#include <NimBLECharacteristic.h>
-#include <NimBLEHIDDevice.h>
-
-#define BLEDevice                  NimBLEDevice
-#define BLEServerCallbacks         NimBLEServerCallbacks
-#define BLECharacteristicCallbacks NimBLECharacteristicCallbacks
-#define BLEHIDDevice               NimBLEHIDDevice
-#define BLECharacteristic          NimBLECharacteristic
-#define BLEAdvertising             NimBLEAdvertising
-#define BLEServer                  NimBLEServer
-
-#else
-#include <BLEHIDDevice.h>
-#include <BLECharacteristic.h>
-#endif // USE_NIMBLE
+#include "HidTransport.h"
+#include "NimbleTransport.h"
 
 #include <Print.h>
+#include <atomic>
+#include <string>
+
+#define HID_REPORT_QUEUE_SIZE 16
+#define HID_REPORT_MAX_LEN 16
+#define NKRO_KEY_COUNT 0x68 // usages 0x00..0x67 as bitmap
+#define GAMEPAD_BUTTON_COUNT 32
+#define GAMEPAD_HAT_CENTER 8 // out of the 0..7 range: null state
+#define TOUCH_MAX_CONTACTS 2
+#define ABS_MOUSE_REPORT_LEN 5 // tip/in-range bits, x, y
+#define HID_DEFAULT_CONN_INTERVAL_US 7500
 
 const uint8_t KEY_LEFT_CTRL = 0x80;
 const uint8_t KEY_LEFT_SHIFT = 0x81;
@@ -86,53 +81,203 @@ typedef struct
   uint8_t keys[6];
 } KeyReport;
 
-class BleComboAbs : public Print, public BLEServerCallbacks, public BLECharacteristicCallbacks
+// N-key-rollover report: modifiers plus one bit per key usage
+typedef struct
+{
+  uint8_t modifiers;
+  uint8_t keys[NKRO_KEY_COUNT / 8];
+} NkroReport;
+
+// Gamepad report: one bit per button, hat direction 0..7 clockwise from up
+typedef struct
+{
+  uint8_t buttons[GAMEPAD_BUTTON_COUNT / 8];
+  uint8_t hat;
+} GamepadReport;
+
+// One finger of the multi-touch report, coordinates 0..10000 little endian
+typedef struct
+{
+  uint8_t tip;
+  uint8_t id;
+  uint8_t x[2];
+  uint8_t y[2];
+} TouchContact;
+
+typedef struct
+{
+  TouchContact contacts[TOUCH_MAX_CONTACTS];
+  uint8_t count;
+} TouchReport;
+
+// Notify pacing and latency of sent reports, latency is enqueue to accepted in microseconds
+typedef struct
+{
+  uint32_t sent;
+  uint32_t failed;
+  uint32_t retries;
+  uint32_t dropped;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+  uint32_t connIntervalUs;
+} ReportStats;
+
+// Connection parameters the host granted, see HidTransportListener::onLinkParams()
+typedef struct
+{
+  uint32_t intervalUs;
+  uint32_t latency;
+  uint32_t timeoutMs;
+  uint32_t updates;
+} LinkStats;
+
+// Link recovery after a disconnect, times in milliseconds from losing the link
+typedef struct
+{
+  uint32_t disconnects;
+  uint32_t lastConnectMs;     // until a host connected again
+  uint32_t lastFirstReportMs; // until the host took the first report
+  uint32_t maxFirstReportMs;
+} ReconnectStats;
+
+// Keyboard, absolute mouse, gamepad and touch reports of one composite HID
+// device. Report state and pacing live here, the link is an HidTransport
+// (NimBLE by default).
+class BleComboAbs : public Print, public HidTransportListener
 {
 private:
-  BLEHIDDevice* hid;
-  BLECharacteristic* inputKeyboard;
-  BLECharacteristic* outputKeyboard;
-  BLECharacteristic* inputAbsMouse;
-  BLEAdvertising* advertising;
-  KeyReport _keyReport;
-  std::string deviceName;
-  std::string deviceManufacturer;
-  uint8_t batteryLevel;
-  bool connected = false;
-  uint32_t _delay_ms = 7;
+#if defined(CONFIG_BT_ENABLED)
+  NimbleTransport nimble;
+#endif
+  HidTransport* transport = nullptr;
+  KeyReport _keyReport = {};
+  uint8_t _nkroKeys[NKRO_KEY_COUNT / 8] = {};
+  bool nkro = false;
+  std::atomic<bool> connected{false};
+  uint32_t _delay_ms = 0; // optional minimum gap between two notifies
   bool absPressed = false;
   bool debugEnabled = false;
 
-  void delay_ms(uint64_t ms);
+  // Reports wait here until the controller accepts them, owned by the loop task
+  typedef struct
+  {
+    uint8_t id;
+    uint8_t length;
+    uint8_t data[HID_REPORT_MAX_LEN];
+    int64_t enqueuedUs;
+  } PendingReport;
+
+  enum NotifyResult : uint8_t
+  {
+    NOTIFY_IDLE,
+    NOTIFY_OUTSTANDING,
+    NOTIFY_DONE,
+    NOTIFY_RETRY,
+    NOTIFY_FAILED
+  };
+
+  PendingReport reports[HID_REPORT_QUEUE_SIZE];
+  uint8_t reportCount = 0;
+  int64_t nextSendUs = 0;
+  int64_t notifyStartUs = 0;
+  uint32_t connIntervalUs = HID_DEFAULT_CONN_INTERVAL_US;
+  ReportStats reportStats = {};
+  // Written by the transport in onSendComplete(), read by the loop
+  std::atomic<uint8_t> notifyResult{NOTIFY_IDLE};
+  std::atomic<uint32_t> notifyDoneUs{0};
+  // Reconnect timing, the link events come from the transport's task
+  std::atomic<uint32_t> disconnectCount{0};
+  std::atomic<uint32_t> disconnectMs{0};
+  std::atomic<uint32_t> connectMs{0};
+  std::atomic<bool> awaitingFirstReport{false};
+  ReconnectStats reconnectStats = {};
+  // Link profile asked for after connecting, and what the host made of it
+  HidLinkParams linkRequest = {};
+  bool linkRequested = false;
+  std::atomic<uint32_t> linkLatency{0};
+  std::atomic<uint32_t> linkTimeoutMs{0};
+  std::atomic<uint32_t> linkUpdates{0};
+  LinkStats linkStats = {};
+
+  // Changes within one loop tick are merged into one report per report ID by flush()
+  KeyReport _sentKeyReport = {};
+  uint8_t _sentNkroKeys[NKRO_KEY_COUNT / 8] = {};
+  bool keysDirty = false;
+  uint8_t absState = 0;
+  int16_t absX = 0;
+  int16_t absY = 0;
+  bool absDirty = false;
+  GamepadReport _gamepad = {{0}, GAMEPAD_HAT_CENTER};
+  GamepadReport _sentGamepad = {{0}, GAMEPAD_HAT_CENTER};
+  bool gamepadDirty = false;
+  TouchReport _touch = {};
+  TouchReport _sentTouch = {};
+  bool touchDirty = false;
+
+  bool hasNewKeys(void);
+  bool releasedUnsent(uint8_t modifiers, uint8_t k);
+  bool addUsage(uint8_t k);
+  void removeUsage(uint8_t k);
+  void flushKeys(void);
+  void flushAbs(void);
+  void flushGamepad(void);
+  void flushTouch(void);
+  void setAbs(uint8_t state, int16_t x, int16_t y);
+  void queueReport(uint8_t id, const uint8_t* data, uint8_t length);
+  void finishNotify(int64_t now);
   void sendKeyboardReport(KeyReport* keys);
   void sendAbsMouseReport(uint8_t state, int16_t x, int16_t y);
 
 public:
   BleComboAbs(std::string deviceName = "ESP32 Combo HID", std::string deviceManufacturer = "Espressif", uint8_t batteryLevel = 100);
+  void setTransport(HidTransport* transport);
   void begin(void);
   void end(void);
   size_t press(uint8_t k);
   size_t release(uint8_t k);
+  size_t pressReport(const KeyReport& report);
+  size_t releaseReport(const KeyReport& report);
   size_t write(uint8_t c);
   size_t write(const uint8_t* buffer, size_t size);
   void releaseAll(void);
   bool isConnected(void);
   void setBatteryLevel(uint8_t level);
   void setName(std::string deviceName);
+  void setAdvertising(const AdvertisingPolicy& policy);
+  void setLinkProfile(const HidLinkParams& params);
   void setDelay(uint32_t ms);
   void setDebug(bool enabled);
+  void setNkro(bool enabled);
+  bool isNkro(void);
+  void flush(void);
+  void update(void);
+  uint8_t pendingReports(void);
+  uint32_t msUntilReady(void);
+  const ReportStats& getReportStats(void);
+  const ReconnectStats& getReconnectStats(void);
+  const LinkStats& getLinkStats(void);
+
+  static bool parseLinkProfile(const char* name, HidLinkParams& params);
+
+  static uint8_t usageFromAscii(uint8_t c, uint8_t* modifiers);
 
   void clickAbs(int16_t x, int16_t y);
   void moveAbs(int16_t x, int16_t y);
   void releaseAbs(void);
   bool isAbsPressed(void);
 
-protected:
-  virtual void onStarted(BLEServer* pServer) { };
-  virtual void onConnect(BLEServer* pServer) override;
-  virtual void onDisconnect(BLEServer* pServer) override;
-  virtual void onWrite(BLECharacteristic* me) override;
+  void setGamepadButton(uint8_t index, bool pressed);
+  void setGamepadHat(uint8_t hat);
+
+  void setTouch(uint8_t contact, bool down, int16_t x, int16_t y);
+  void releaseTouch(void);
+
+  // HidTransportListener
+  void onTransportConnect(void) override;
+  void onTransportDisconnect(void) override;
+  void onLinkParams(uint32_t intervalUs, uint16_t latency, uint32_t timeoutMs) override;
+  void onSendComplete(HidSendResult result) override;
 };
 
-#endif // CONFIG_BT_ENABLED
 #endif // BLE_COMBO_ABS_H
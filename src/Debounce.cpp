@@ -0,0 +1,174 @@
+#include "Debounce.h"
+
+#include "sdkconfig.h"
+#if defined(CONFIG_IDF_TARGET_ESP32C3)
+#include <soc/io_mux_reg.h>
+#include <soc/gpio_periph.h>
+#endif
+
+#define INTEGRATOR_MAX_SAMPLES 32
+
+static inline uint32_t integratorMask(uint16_t samples)
+{
+  return samples >= INTEGRATOR_MAX_SAMPLES ? 0xFFFFFFFFUL : ((1UL << samples) - 1);
+}
+
+void Debounce::init(uint8_t i, DebounceMode mode, uint16_t time, uint8_t level)
+{
+  DebounceConfig& c = config[i];
+  c.mode = mode;
+  raw[i] = level;
+  stable[i] = level;
+  pending[i] = false;
+  c.time = time;
+  since[i] = 0;
+  if (mode == DEBOUNCE_INTEGRATOR) {
+    if (c.time == 0) {
+      c.time = 1;
+    } else if (c.time > INTEGRATOR_MAX_SAMPLES) {
+      c.time = INTEGRATOR_MAX_SAMPLES;
+    }
+  }
+  c.history = level ? integratorMask(c.time) : 0;
+}
+
+// Shifts the raw level into the history once per elapsed millisecond
+void Debounce::integrate(uint8_t i, unsigned long now)
+{
+  unsigned long samples = now - since[i];
+  if (samples == 0) {
+    return;
+  }
+  since[i] = now;
+  DebounceConfig& c = config[i];
+  uint32_t mask = integratorMask(c.time);
+  if (samples >= INTEGRATOR_MAX_SAMPLES) {
+    c.history = raw[i] ? mask : 0;
+  } else {
+    c.history = (c.history << samples) | (raw[i] ? ((1UL << samples) - 1) : 0);
+  }
+  uint32_t bits = c.history & mask;
+  if (bits == mask) {
+    stable[i] = HIGH;
+  } else if (bits == 0) {
+    stable[i] = LOW;
+  }
+  pending[i] = (raw[i] != stable[i]) || (bits != 0 && bits != mask);
+}
+
+// Feeds a raw edge, returns true if the debounced level changed
+bool Debounce::edge(uint8_t i, uint8_t level, unsigned long now)
+{
+  uint8_t before = stable[i];
+  switch (config[i].mode) {
+    case DEBOUNCE_EAGER:
+    case DEBOUNCE_HARDWARE:
+      raw[i] = level;
+      if (!pending[i] && level != stable[i]) {
+        stable[i] = level;
+        since[i] = now;
+        pending[i] = true;
+      }
+      break;
+    case DEBOUNCE_INTEGRATOR:
+      if (!pending[i]) {
+        since[i] = now;
+      }
+      integrate(i, now);
+      raw[i] = level;
+      pending[i] = true;
+      break;
+    case DEBOUNCE_DELAY:
+    default:
+      raw[i] = level;
+      since[i] = now;
+      pending[i] = (level != stable[i]);
+      break;
+  }
+  return stable[i] != before;
+}
+
+// Advances pending deadlines, returns true if the debounced level changed
+bool Debounce::tick(uint8_t i, unsigned long now)
+{
+  if (!pending[i]) {
+    return false;
+  }
+  uint8_t before = stable[i];
+  switch (config[i].mode) {
+    case DEBOUNCE_EAGER:
+    case DEBOUNCE_HARDWARE:
+      if (now - since[i] >= config[i].time) {
+        pending[i] = false;
+        // Level changed during the lockout: accept it and lock out again
+        if (raw[i] != stable[i]) {
+          stable[i] = raw[i];
+          since[i] = now;
+          pending[i] = true;
+        }
+      }
+      break;
+    case DEBOUNCE_INTEGRATOR:
+      integrate(i, now);
+      break;
+    case DEBOUNCE_DELAY:
+    default:
+      if (now - since[i] >= config[i].time) {
+        stable[i] = raw[i];
+        pending[i] = false;
+      }
+      break;
+  }
+  return stable[i] != before;
+}
+
+// Time at which tick() has to run next, the integrator samples every millisecond
+bool Debounce::nextDeadline(uint8_t i, unsigned long& deadline) const
+{
+  if (!pending[i]) {
+    return false;
+  }
+  deadline = since[i] + (config[i].mode == DEBOUNCE_INTEGRATOR ? 1 : config[i].time);
+  return true;
+}
+
+DebounceMode Debounce::parseMode(const String& name)
+{
+  if (name == "eager") {
+    return DEBOUNCE_EAGER;
+  } else if (name == "integrator") {
+    return DEBOUNCE_INTEGRATOR;
+  } else if (name == "hardware") {
+    return DEBOUNCE_HARDWARE;
+  }
+  return DEBOUNCE_DELAY;
+}
+
+const char* Debounce::modeName(DebounceMode mode)
+{
+  switch (mode) {
+    case DEBOUNCE_EAGER:
+      return "eager";
+    case DEBOUNCE_INTEGRATOR:
+      return "integrator";
+    case DEBOUNCE_HARDWARE:
+      return "hardware";
+    default:
+      return "delay";
+  }
+}
+
+// Enables the IO MUX glitch filter of the pin, returns false if the chip has none
+bool Debounce::enableHardwareFilter(uint8_t pin)
+{
+#if defined(CONFIG_IDF_TARGET_ESP32C3) && defined(FILTER_EN)
+  if (pin >= SOC_GPIO_PIN_COUNT || GPIO_PIN_MUX_REG[pin] == 0) {
+    return false;
+  }
+  PIN_FILTER_EN(GPIO_PIN_MUX_REG[pin]);
+  return true;
+#else
+  (void)pin;
+  return false;
+#endif
+}
@@ -0,0 +1,52 @@
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include <Arduino.h>
+
+// Debounce algorithms selectable per button
+enum DebounceMode : uint8_t
+{
+  DEBOUNCE_DELAY,      // accept a level once it was stable for `time` ms
+  DEBOUNCE_EAGER,      // accept the first edge at once, then lock out bounce for `time` ms
+  DEBOUNCE_INTEGRATOR, // shift register with 1 ms samples, accept after `time` equal samples (max 32)
+  DEBOUNCE_HARDWARE    // GPIO glitch filter where available, plus eager lockout in software
+};
+
+#define DEBOUNCE_MAX_INPUTS 64
+
+// Mode-specific settings and data of one input, only read by the mode's own steps
+typedef struct
+{
+  uint8_t mode;
+  uint16_t time;
+  uint32_t history; // integrator samples, newest in bit 0
+} DebounceConfig;
+
+// Debounce state of all inputs. The fields every edge and tick touches are
+// parallel arrays indexed by input, so a scan over many inputs walks dense
+// memory; the mode-specific data lives beside them in `config`.
+class Debounce
+{
+private:
+  uint8_t raw[DEBOUNCE_MAX_INPUTS];        // last raw level seen
+  uint8_t stable[DEBOUNCE_MAX_INPUTS];     // debounced level
+  bool pending[DEBOUNCE_MAX_INPUTS];       // deadline outstanding, tick() has to be called
+  unsigned long since[DEBOUNCE_MAX_INPUTS]; // last change or lockout start
+  DebounceConfig config[DEBOUNCE_MAX_INPUTS];
+
+  void integrate(uint8_t i, unsigned long now);
+
+public:
+  void init(uint8_t i, DebounceMode mode, uint16_t time, uint8_t level);
+  bool edge(uint8_t i, uint8_t level, unsigned long now);
+  bool tick(uint8_t i, unsigned long now);
+  bool nextDeadline(uint8_t i, unsigned long& deadline) const;
+  uint8_t level(uint8_t i) const { return stable[i]; }
+  uint8_t rawLevel(uint8_t i) const { return raw[i]; }
+
+  static DebounceMode parseMode(const String& name);
+  static const char* modeName(DebounceMode mode);
+  static bool enableHardwareFilter(uint8_t pin);
+};
+
+#endif // DEBOUNCE_H
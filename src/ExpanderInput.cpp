@@ -0,0 +1,194 @@
+#include "ExpanderInput.h"
+#include <esp_timer.h>
+
+// MCP23017 registers in the default IOCON.BANK = 0 layout
+#define MCP23017_IODIRA 0x00
+#define MCP23017_IODIRB 0x01
+#define MCP23017_GPINTENA 0x04
+#define MCP23017_GPINTENB 0x05
+#define MCP23017_IOCON 0x0A
+#define MCP23017_GPPUA 0x0C
+#define MCP23017_GPPUB 0x0D
+#define MCP23017_GPIOA 0x12
+#define MCP23017_IOCON_MIRROR 0x40
+#define MCP23017_IOCON_ODR 0x04
+
+bool ExpanderInput::begin(GpioInput* gpio, TwoWire& bus, ExpanderType expanderType, uint8_t addr, int interruptPin)
+{
+  wire = &bus;
+  type = expanderType;
+  address = addr;
+  intPin = interruptPin;
+  stats = {};
+
+  bool ok = true;
+  switch (type) {
+    case EXPANDER_PCF8574:
+      // Quasi-bidirectional pins, writing 1 turns them into weak pull-up inputs
+      wire->beginTransmission(address);
+      wire->write(0xFF);
+      ok = wire->endTransmission() == 0;
+      break;
+    case EXPANDER_PCF8575:
+      wire->beginTransmission(address);
+      wire->write(0xFF);
+      wire->write(0xFF);
+      ok = wire->endTransmission() == 0;
+      break;
+    case EXPANDER_MCP23017:
+      // Both ports as inputs with pull-ups, INTA/INTB mirrored as one open-drain line
+      ok = writeRegister(MCP23017_IOCON, MCP23017_IOCON_MIRROR | MCP23017_IOCON_ODR)
+        && writeRegister(MCP23017_IODIRA, 0xFF)
+        && writeRegister(MCP23017_IODIRB, 0xFF)
+        && writeRegister(MCP23017_GPPUA, 0xFF)
+        && writeRegister(MCP23017_GPPUB, 0xFF)
+        && writeRegister(MCP23017_GPINTENA, 0xFF)
+        && writeRegister(MCP23017_GPINTENB, 0xFF);
+      break;
+    default:
+      ok = false;
+      break;
+  }
+  if (!ok) {
+    type = EXPANDER_NONE;
+    return false;
+  }
+
+  // Initial read also clears a pending interrupt
+  uint16_t value;
+  if (!readPins(value)) {
+    type = EXPANDER_NONE;
+    return false;
+  }
+  levels = value;
+
+  if (intPin >= 0 && gpio != nullptr) {
+    pinMode(intPin, INPUT_PULLUP);
+    gpio->attach((uint8_t)intPin);
+  }
+  return true;
+}
+
+bool ExpanderInput::isConfigured(void)
+{
+  return type != EXPANDER_NONE;
+}
+
+uint8_t ExpanderInput::pinCount(void)
+{
+  return type == EXPANDER_PCF8574 ? 8 : (type == EXPANDER_NONE ? 0 : 16);
+}
+
+bool ExpanderInput::isInterruptPin(uint8_t pin)
+{
+  return intPin >= 0 && pin == intPin;
+}
+
+// INT is active low and stays asserted until the port has been read
+bool ExpanderInput::interruptPending(void)
+{
+  return intPin >= 0 && GpioInput::readLevel((uint8_t)intPin) == LOW;
+}
+
+uint16_t ExpanderInput::level(void)
+{
+  return levels;
+}
+
+bool ExpanderInput::writeRegister(uint8_t reg, uint8_t value)
+{
+  wire->beginTransmission(address);
+  wire->write(reg);
+  wire->write(value);
+  return wire->endTransmission() == 0;
+}
+
+// One bus transaction for all pins, bit n is expander pin n (MCP23017: GPA0..7, GPB0..7)
+bool ExpanderInput::readPins(uint16_t& value)
+{
+  uint8_t count = pinCount();
+  int64_t start = esp_timer_get_time();
+  bool ok = true;
+  if (type == EXPANDER_MCP23017) {
+    wire->beginTransmission(address);
+    wire->write(MCP23017_GPIOA);
+    ok = wire->endTransmission(false) == 0;
+  }
+  if (ok) {
+    // Exact match of TwoWire::requestFrom(uint16_t, size_t), mixed types are ambiguous on arduino-esp32 2.x
+    size_t bytes = count / 8;
+    ok = wire->requestFrom((uint16_t)address, bytes) == bytes;
+  }
+  if (ok) {
+    value = (uint8_t)wire->read();
+    if (count > 8) {
+      value |= (uint16_t)((uint8_t)wire->read()) << 8;
+    } else {
+      value |= 0xFF00;
+    }
+  }
+  uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+  stats.reads++;
+  stats.lastUs = elapsed;
+  stats.totalUs += elapsed;
+  if (elapsed > stats.maxUs) {
+    stats.maxUs = elapsed;
+  }
+  if (!ok) {
+    stats.errors++;
+  }
+  return ok;
+}
+
+// Reads the port and returns the pins that changed since the last read. Edges
+// that arrive during the transaction keep INT asserted, so it is re-read while
+// the line is still low (bounded to avoid spinning on a stuck line).
+bool ExpanderInput::read(uint16_t& changed)
+{
+  changed = 0;
+  if (type == EXPANDER_NONE) {
+    return false;
+  }
+  uint8_t attempts = 0;
+  do {
+    uint16_t value;
+    if (!readPins(value)) {
+      return false;
+    }
+    changed |= value ^ levels;
+    levels = value;
+  } while (interruptPending() && ++attempts < EXPANDER_MAX_REREADS);
+  return true;
+}
+
+const ExpanderStats& ExpanderInput::getStats(void)
+{
+  return stats;
+}
+
+ExpanderType ExpanderInput::parseType(const String& name)
+{
+  if (name == "pcf8574") {
+    return EXPANDER_PCF8574;
+  } else if (name == "pcf8575") {
+    return EXPANDER_PCF8575;
+  } else if (name == "mcp23017") {
+    return EXPANDER_MCP23017;
+  }
+  return EXPANDER_NONE;
+}
+
+const char* ExpanderInput::typeName(ExpanderType expanderType)
+{
+  switch (expanderType) {
+    case EXPANDER_PCF8574:
+      return "pcf8574";
+    case EXPANDER_PCF8575:
+      return "pcf8575";
+    case EXPANDER_MCP23017:
+      return "mcp23017";
+    default:
+      return "none";
+  }
+}
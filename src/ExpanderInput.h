@@ -0,0 +1,59 @@
+#ifndef EXPANDER_INPUT_H
+#define EXPANDER_INPUT_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "GpioInput.h"
+
+#define EXPANDER_MAX_PINS 16
+#define EXPANDER_MAX_REREADS 4
+
+enum ExpanderType : uint8_t
+{
+  EXPANDER_NONE,
+  EXPANDER_PCF8574,
+  EXPANDER_PCF8575,
+  EXPANDER_MCP23017
+};
+
+// Bus timing of the expander reads, all times in microseconds
+typedef struct
+{
+  uint32_t reads;
+  uint32_t errors;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+} ExpanderStats;
+
+// Button inputs on an I2C port expander. All pins are read with a single bus
+// transaction, triggered by the expander's open-drain INT line instead of polling.
+class ExpanderInput
+{
+private:
+  TwoWire* wire = nullptr;
+  ExpanderType type = EXPANDER_NONE;
+  uint8_t address = 0;
+  int intPin = -1;
+  uint16_t levels = 0xFFFF;
+  ExpanderStats stats = {};
+
+  bool writeRegister(uint8_t reg, uint8_t value);
+  bool readPins(uint16_t& value);
+
+public:
+  bool begin(GpioInput* gpio, TwoWire& bus, ExpanderType type, uint8_t address, int intPin);
+  bool isConfigured(void);
+  uint8_t pinCount(void);
+  bool isInterruptPin(uint8_t pin);
+  bool interruptPending(void);
+  uint16_t level(void);
+
+  bool read(uint16_t& changed);
+  const ExpanderStats& getStats(void);
+
+  static ExpanderType parseType(const String& name);
+  static const char* typeName(ExpanderType type);
+};
+
+#endif // EXPANDER_INPUT_H
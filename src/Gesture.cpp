@@ -0,0 +1,268 @@
+#include "Gesture.h"
+
+#define BIT64(b) ((uint64_t)1 << (b))
+
+void GestureEngine::setCallback(GestureCallback cb)
+{
+  callback = cb;
+}
+
+void GestureEngine::clear(uint8_t b)
+{
+  if (b >= GESTURE_MAX_BUTTONS) {
+    return;
+  }
+  GestureTable& t = tables[b];
+  for (int n = 0; n <= GESTURE_MAX_TAPS; n++) {
+    t.tap[n] = GESTURE_NONE;
+    t.plan[n] = 0;
+  }
+  for (int n = 0; n < GESTURE_MAX_TAPS; n++) {
+    t.hold[n] = GESTURE_NONE;
+  }
+  t.tapTerm = 0;
+  t.holdTerm = 0;
+  t.repeatDelay = 0;
+  t.repeatInterval = 0;
+  t.policy = HOLD_TIMEOUT;
+  state[b] = GESTURE_IDLE;
+  repeatAction[b] = GESTURE_NONE;
+  taps[b] = 0;
+  since[b] = 0;
+  otherPressed[b] = 0;
+  down &= ~BIT64(b);
+}
+
+void GestureEngine::bindTap(uint8_t b, uint8_t count, int16_t action)
+{
+  if (b < GESTURE_MAX_BUTTONS && count >= 1 && count <= GESTURE_MAX_TAPS) {
+    tables[b].tap[count] = action;
+  }
+}
+
+void GestureEngine::bindHold(uint8_t b, uint8_t count, int16_t action)
+{
+  if (b < GESTURE_MAX_BUTTONS && count < GESTURE_MAX_TAPS) {
+    tables[b].hold[count] = action;
+  }
+}
+
+// Precomputes per completed tap count whether a hold is bound and whether
+// waiting for further taps is needed, so press/release decide in O(1)
+void GestureEngine::compile(uint8_t b, uint16_t tapTerm, uint16_t holdTerm, HoldPolicy policy)
+{
+  if (b >= GESTURE_MAX_BUTTONS) {
+    return;
+  }
+  GestureTable& t = tables[b];
+  t.tapTerm = tapTerm;
+  t.holdTerm = holdTerm;
+  t.policy = policy;
+  for (int k = 0; k <= GESTURE_MAX_TAPS; k++) {
+    uint8_t plan = 0;
+    if (k < GESTURE_MAX_TAPS && t.hold[k] != GESTURE_NONE) {
+      plan |= GESTURE_PLAN_HOLD;
+    }
+    for (int n = k + 2; n <= GESTURE_MAX_TAPS; n++) {
+      if (t.tap[n] != GESTURE_NONE) {
+        plan |= GESTURE_PLAN_MORE;
+      }
+    }
+    for (int n = k + 1; n < GESTURE_MAX_TAPS; n++) {
+      if (t.hold[n] != GESTURE_NONE) {
+        plan |= GESTURE_PLAN_MORE;
+      }
+    }
+    t.plan[k] = plan;
+  }
+}
+
+// Typematic repeat: the held action fires again after `delay`, then every `interval` ms
+void GestureEngine::setRepeat(uint8_t b, uint16_t delay, uint16_t interval)
+{
+  if (b < GESTURE_MAX_BUTTONS) {
+    tables[b].repeatDelay = interval > 0 ? delay : 0;
+    tables[b].repeatInterval = interval;
+  }
+}
+
+void GestureEngine::fire(uint8_t b, int16_t action, uint8_t count, bool hold)
+{
+  if (callback != nullptr && action != GESTURE_NONE) {
+    callback(b, action, count, hold, false);
+  }
+}
+
+void GestureEngine::startRepeat(uint8_t b, int16_t action, unsigned long now)
+{
+  if (tables[b].repeatInterval > 0 && action != GESTURE_NONE) {
+    repeatAction[b] = action;
+    repeatNext[b] = now + tables[b].repeatDelay;
+  }
+}
+
+// Sends the action for `count` taps; unbound counts replay as single taps
+void GestureEngine::resolveTaps(uint8_t b, uint8_t count)
+{
+  const GestureTable& t = tables[b];
+  if (t.tap[count] != GESTURE_NONE) {
+    fire(b, t.tap[count], count, false);
+  } else {
+    for (uint8_t n = 0; n < count; n++) {
+      fire(b, t.tap[1], 1, false);
+    }
+  }
+}
+
+void GestureEngine::resolveHold(uint8_t b, unsigned long now)
+{
+  down &= ~BIT64(b);
+  state[b] = GESTURE_HELD;
+  fire(b, tables[b].hold[taps[b]], taps[b], true);
+  startRepeat(b, tables[b].hold[taps[b]], now);
+}
+
+void GestureEngine::press(uint8_t b, unsigned long now)
+{
+  if (b >= GESTURE_MAX_BUTTONS) {
+    return;
+  }
+  // Other buttons waiting for a hold decision see this press first
+  uint64_t pending = down & ~BIT64(b);
+  while (pending) {
+    uint8_t o = __builtin_ctzll(pending);
+    pending &= pending - 1;
+    if (tables[o].policy == HOLD_ON_OTHER_KEY_PRESS) {
+      resolveHold(o, now);
+    } else if (tables[o].policy == HOLD_PERMISSIVE) {
+      otherPressed[o] |= BIT64(b);
+    }
+  }
+
+  if (state[b] != GESTURE_IDLE && state[b] != GESTURE_UP) {
+    return;
+  }
+  if (state[b] == GESTURE_IDLE) {
+    taps[b] = 0;
+  }
+  const GestureTable& t = tables[b];
+  uint8_t plan = t.plan[taps[b]];
+  if (!(plan & (GESTURE_PLAN_HOLD | GESTURE_PLAN_MORE))) {
+    // This press can only end as the next tap: no reason to wait for release
+    resolveTaps(b, taps[b] + 1);
+    state[b] = GESTURE_HELD;
+    if (t.tap[taps[b] + 1] != GESTURE_NONE) {
+      startRepeat(b, t.tap[taps[b] + 1], now);
+    }
+    return;
+  }
+  state[b] = GESTURE_DOWN;
+  since[b] = now;
+  otherPressed[b] = 0;
+  if (plan & GESTURE_PLAN_HOLD) {
+    down |= BIT64(b);
+  }
+}
+
+void GestureEngine::release(uint8_t b, unsigned long now)
+{
+  if (b >= GESTURE_MAX_BUTTONS) {
+    return;
+  }
+  // Permissive hold: another button was tapped completely inside this press
+  uint64_t pending = down & ~BIT64(b);
+  while (pending) {
+    uint8_t o = __builtin_ctzll(pending);
+    pending &= pending - 1;
+    if (tables[o].policy == HOLD_PERMISSIVE && (otherPressed[o] & BIT64(b))) {
+      resolveHold(o, now);
+    }
+  }
+
+  if (state[b] == GESTURE_HELD) {
+    state[b] = GESTURE_IDLE;
+    repeatAction[b] = GESTURE_NONE;
+    return;
+  }
+  if (state[b] != GESTURE_DOWN) {
+    return;
+  }
+  down &= ~BIT64(b);
+  taps[b]++;
+  if (taps[b] >= GESTURE_MAX_TAPS || !(tables[b].plan[taps[b] - 1] & GESTURE_PLAN_MORE)) {
+    resolveTaps(b, taps[b]);
+    state[b] = GESTURE_IDLE;
+    return;
+  }
+  state[b] = GESTURE_UP;
+  since[b] = now;
+}
+
+void GestureEngine::tick(uint8_t b, unsigned long now)
+{
+  if (b >= GESTURE_MAX_BUTTONS) {
+    return;
+  }
+  const GestureTable& t = tables[b];
+  if (state[b] == GESTURE_DOWN) {
+    if ((t.plan[taps[b]] & GESTURE_PLAN_HOLD) && now - since[b] > t.holdTerm) {
+      resolveHold(b, now);
+    }
+  } else if (state[b] == GESTURE_UP) {
+    if (now - since[b] > t.tapTerm) {
+      resolveTaps(b, taps[b]);
+      state[b] = GESTURE_IDLE;
+    }
+  } else if (state[b] == GESTURE_HELD && repeatAction[b] != GESTURE_NONE) {
+    if ((long)(now - repeatNext[b]) >= 0) {
+      if (callback != nullptr) {
+        callback(b, repeatAction[b], taps[b], false, true);
+      }
+      // A late tick sends one repeat, not a burst of the missed ones
+      repeatNext[b] += t.repeatInterval;
+      if ((long)(now - repeatNext[b]) >= 0) {
+        repeatNext[b] = now + t.repeatInterval;
+      }
+    }
+  }
+}
+
+bool GestureEngine::isActive(uint8_t b)
+{
+  return b < GESTURE_MAX_BUTTONS && state[b] != GESTURE_IDLE;
+}
+
+// Time at which tick() can next decide something for this button
+bool GestureEngine::nextDeadline(uint8_t b, unsigned long& deadline)
+{
+  if (b >= GESTURE_MAX_BUTTONS) {
+    return false;
+  }
+  const GestureTable& t = tables[b];
+  if (state[b] == GESTURE_DOWN && (t.plan[taps[b]] & GESTURE_PLAN_HOLD)) {
+    deadline = since[b] + t.holdTerm + 1;
+    return true;
+  } else if (state[b] == GESTURE_UP) {
+    deadline = since[b] + t.tapTerm + 1;
+    return true;
+  } else if (state[b] == GESTURE_HELD && repeatAction[b] != GESTURE_NONE) {
+    deadline = repeatNext[b];
+    return true;
+  }
+  return false;
+}
+
+bool GestureEngine::firesOnPress(uint8_t b)
+{
+  return b < GESTURE_MAX_BUTTONS && !(tables[b].plan[0] & (GESTURE_PLAN_HOLD | GESTURE_PLAN_MORE));
+}
+
+HoldPolicy GestureEngine::parsePolicy(const String& name)
+{
+  if (name == "hold_on_other_key_press") {
+    return HOLD_ON_OTHER_KEY_PRESS;
+  } else if (name == "permissive_hold") {
+    return HOLD_PERMISSIVE;
+  }
+  return HOLD_TIMEOUT;
+}
@@ -0,0 +1,83 @@
+#ifndef GESTURE_H
+#define GESTURE_H
+
+#include <Arduino.h>
+
+#define GESTURE_MAX_BUTTONS 64
+#define GESTURE_MAX_TAPS 8
+#define GESTURE_NONE -1
+
+// Decision flags compiled per number of completed taps
+#define GESTURE_PLAN_HOLD 0x01 // a hold after this many taps is bound
+#define GESTURE_PLAN_MORE 0x02 // after the next release another gesture is still possible
+
+// How a bound hold is decided while another button is pressed (QMK semantics)
+enum HoldPolicy : uint8_t
+{
+  HOLD_TIMEOUT,            // hold only after holdTerm
+  HOLD_ON_OTHER_KEY_PRESS, // hold as soon as another button goes down
+  HOLD_PERMISSIVE          // hold as soon as another button is pressed and released
+};
+
+enum GestureState : uint8_t
+{
+  GESTURE_IDLE,
+  GESTURE_DOWN, // pressed, not decided yet
+  GESTURE_UP,   // released, waiting for a further tap
+  GESTURE_HELD  // action sent, waiting for release
+};
+
+// Compiled gesture table of one button
+typedef struct
+{
+  int16_t tap[GESTURE_MAX_TAPS + 1];  // action for n taps, index 1..GESTURE_MAX_TAPS
+  int16_t hold[GESTURE_MAX_TAPS];     // action for hold after n taps, index 0..GESTURE_MAX_TAPS-1
+  uint8_t plan[GESTURE_MAX_TAPS + 1]; // GESTURE_PLAN_* per completed tap count
+  uint16_t tapTerm;
+  uint16_t holdTerm;
+  uint16_t repeatDelay;    // typematic repeat of the held action, 0 = off
+  uint16_t repeatInterval;
+  uint8_t policy;
+} GestureTable;
+
+// Called for every decided gesture; taps is the tap count, hold marks a (tap-then-)hold,
+// repeat marks a typematic repeat of the action already sent for this press
+typedef void (*GestureCallback)(uint8_t button, int16_t action, uint8_t taps, bool hold, bool repeat);
+
+class GestureEngine
+{
+private:
+  GestureTable tables[GESTURE_MAX_BUTTONS];
+  uint8_t state[GESTURE_MAX_BUTTONS];
+  uint8_t taps[GESTURE_MAX_BUTTONS];
+  unsigned long since[GESTURE_MAX_BUTTONS];
+  int16_t repeatAction[GESTURE_MAX_BUTTONS];        // action repeated while held
+  unsigned long repeatNext[GESTURE_MAX_BUTTONS];
+  uint64_t otherPressed[GESTURE_MAX_BUTTONS]; // buttons pressed while this one was down
+  uint64_t down = 0;                          // buttons in GESTURE_DOWN with a bound hold
+  GestureCallback callback = nullptr;
+
+  void fire(uint8_t b, int16_t action, uint8_t count, bool hold);
+  void resolveTaps(uint8_t b, uint8_t count);
+  void resolveHold(uint8_t b, unsigned long now);
+  void startRepeat(uint8_t b, int16_t action, unsigned long now);
+
+public:
+  void setCallback(GestureCallback cb);
+  void clear(uint8_t b);
+  void bindTap(uint8_t b, uint8_t count, int16_t action);
+  void bindHold(uint8_t b, uint8_t count, int16_t action);
+  void compile(uint8_t b, uint16_t tapTerm, uint16_t holdTerm, HoldPolicy policy);
+  void setRepeat(uint8_t b, uint16_t delay, uint16_t interval);
+
+  void press(uint8_t b, unsigned long now);
+  void release(uint8_t b, unsigned long now);
+  void tick(uint8_t b, unsigned long now);
+  bool isActive(uint8_t b);
+  bool nextDeadline(uint8_t b, unsigned long& deadline);
+  bool firesOnPress(uint8_t b);
+
+  static HoldPolicy parsePolicy(const String& name);
+};
+
+#endif // GESTURE_H
@@ -0,0 +1,75 @@
+#include "GpioInput.h"
+
+#include <esp_timer.h>
+
+SpscRing<InputEvent, GPIO_INPUT_QUEUE_SIZE> GpioInput::queue;
+TaskHandle_t GpioInput::waiter = NULL;
+
+void IRAM_ATTR GpioInput::onEdge(void* arg)
+{
+  InputEvent ev;
+  ev.pin = (uint8_t)(uintptr_t)arg;
+  ev.level = (uint8_t)readLevel(ev.pin);
+  ev.timeUs = esp_timer_get_time();
+  queue.push(ev);
+
+  if (waiter != NULL) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(waiter, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+}
+
+void GpioInput::begin(void)
+{
+  waiter = xTaskGetCurrentTaskHandle();
+}
+
+bool GpioInput::attach(uint8_t pin)
+{
+  if (pin > GPIO_INPUT_MAX_PIN) {
+    return false;
+  }
+  attachInterruptArg(pin, onEdge, (void*)(uintptr_t)pin, CHANGE);
+  return true;
+}
+
+void GpioInput::detach(uint8_t pin)
+{
+  if (pin <= GPIO_INPUT_MAX_PIN) {
+    detachInterrupt(pin);
+  }
+}
+
+bool GpioInput::poll(InputEvent& ev)
+{
+  return queue.pop(ev);
+}
+
+bool GpioInput::waitForEvent(uint32_t timeoutMs)
+{
+  if (!queue.isEmpty()) {
+    return true;
+  }
+  return ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs)) > 0;
+}
+
+uint32_t GpioInput::droppedEvents(void)
+{
+  return queue.droppedCount();
+}
+
+void GpioInput::setScanMask(uint64_t mask)
+{
+  scanMask = mask;
+  lastLevels = readAll() & mask;
+}
+
+// Returns the masked pins whose level changed since the previous scan
+uint64_t GpioInput::scan(uint64_t& levels)
+{
+  levels = readAll() & scanMask;
+  uint64_t changed = levels ^ lastLevels;
+  lastLevels = levels;
+  return changed;
+}
@@ -0,0 +1,54 @@
+#ifndef GPIO_INPUT_H
+#define GPIO_INPUT_H
+
+#include <Arduino.h>
+#include <soc/soc.h>
+#include <soc/gpio_reg.h>
+#include "InputEvents.h"
+
+#define GPIO_INPUT_QUEUE_SIZE 64
+#define GPIO_INPUT_MAX_PIN 39
+
+class GpioInput
+{
+private:
+  static SpscRing<InputEvent, GPIO_INPUT_QUEUE_SIZE> queue;
+  static TaskHandle_t waiter;
+  uint64_t scanMask = 0;
+  uint64_t lastLevels = 0;
+
+  static void onEdge(void* arg);
+
+public:
+  void begin(void);
+  bool attach(uint8_t pin);
+  void detach(uint8_t pin);
+  bool poll(InputEvent& ev);
+  bool waitForEvent(uint32_t timeoutMs);
+  uint32_t droppedEvents(void);
+  void setScanMask(uint64_t mask);
+  uint64_t scan(uint64_t& levels);
+
+  // Reads the pin level straight from the GPIO input register (ISR safe)
+  static inline int readLevel(uint8_t pin)
+  {
+#if defined(GPIO_IN1_REG)
+    if (pin >= 32) {
+      return (REG_READ(GPIO_IN1_REG) >> (pin - 32)) & 0x1;
+    }
+#endif
+    return (REG_READ(GPIO_IN_REG) >> pin) & 0x1;
+  }
+
+  // Reads the levels of all pins at once, bit n is GPIO n
+  static inline uint64_t readAll(void)
+  {
+    uint64_t levels = REG_READ(GPIO_IN_REG);
+#if defined(GPIO_IN1_REG)
+    levels |= (uint64_t)REG_READ(GPIO_IN1_REG) << 32;
+#endif
+    return levels;
+  }
+};
+
+#endif // GPIO_INPUT_H
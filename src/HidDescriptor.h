@@ -0,0 +1,202 @@
+#ifndef HID_DESCRIPTOR_H
+#define HID_DESCRIPTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+// Compile-time HID report descriptor builder. Items are fixed-size byte blocks
+// joined with operator+, each collection gets its report ID from its position
+// in Descriptor<...>, and reportBytes() walks the finished descriptor so report
+// structs can be checked against it with static_assert.
+namespace hid
+{
+
+template <size_t N>
+struct Bytes
+{
+  uint8_t data[N];
+  static constexpr size_t size = N;
+};
+
+template <size_t A, size_t B>
+constexpr Bytes<A + B> operator+(const Bytes<A>& a, const Bytes<B>& b)
+{
+  Bytes<A + B> r{};
+  for (size_t i = 0; i < A; i++) {
+    r.data[i] = a.data[i];
+  }
+  for (size_t i = 0; i < B; i++) {
+    r.data[A + i] = b.data[i];
+  }
+  return r;
+}
+
+// Short item with the smallest data size that holds the value
+template <uint8_t Prefix, uint32_t Value>
+constexpr auto item()
+{
+  if constexpr (Value <= 0xFF) {
+    return Bytes<2>{{(uint8_t)(Prefix | 1), (uint8_t)Value}};
+  } else if constexpr (Value <= 0xFFFF) {
+    return Bytes<3>{{(uint8_t)(Prefix | 2), (uint8_t)Value, (uint8_t)(Value >> 8)}};
+  } else {
+    return Bytes<5>{{(uint8_t)(Prefix | 3), (uint8_t)Value, (uint8_t)(Value >> 8), (uint8_t)(Value >> 16), (uint8_t)(Value >> 24)}};
+  }
+}
+
+// Logical and physical limits are signed: 0x80..0xFF need two bytes
+template <uint8_t Prefix, int32_t Value>
+constexpr auto signedItem()
+{
+  if constexpr (Value >= -128 && Value <= 127) {
+    return Bytes<2>{{(uint8_t)(Prefix | 1), (uint8_t)Value}};
+  } else if constexpr (Value >= -32768 && Value <= 32767) {
+    return Bytes<3>{{(uint8_t)(Prefix | 2), (uint8_t)Value, (uint8_t)(Value >> 8)}};
+  } else {
+    return Bytes<5>{{(uint8_t)(Prefix | 3), (uint8_t)Value, (uint8_t)(Value >> 8), (uint8_t)(Value >> 16), (uint8_t)(Value >> 24)}};
+  }
+}
+
+enum : uint8_t
+{
+  TAG_INPUT = 0x80,
+  TAG_OUTPUT = 0x90,
+  TAG_COLLECTION = 0xA0,
+  TAG_FEATURE = 0xB0,
+  TAG_END_COLLECTION = 0xC0,
+  TAG_USAGE_PAGE = 0x04,
+  TAG_LOGICAL_MINIMUM = 0x14,
+  TAG_LOGICAL_MAXIMUM = 0x24,
+  TAG_PHYSICAL_MINIMUM = 0x34,
+  TAG_PHYSICAL_MAXIMUM = 0x44,
+  TAG_UNIT = 0x64,
+  TAG_REPORT_SIZE = 0x74,
+  TAG_REPORT_ID = 0x84,
+  TAG_REPORT_COUNT = 0x94,
+  TAG_USAGE = 0x08,
+  TAG_USAGE_MINIMUM = 0x18,
+  TAG_USAGE_MAXIMUM = 0x28
+};
+
+// Main item flags
+enum : uint8_t
+{
+  DATA_ARRAY_ABS = 0x00,
+  CONSTANT = 0x01,
+  DATA_VAR_ABS = 0x02,
+  DATA_VAR_ABS_NULL = 0x42
+};
+
+// Collection types
+enum : uint8_t
+{
+  PHYSICAL = 0x00,
+  APPLICATION = 0x01,
+  LOGICAL = 0x02
+};
+
+template <uint32_t V> constexpr auto usagePage() { return item<TAG_USAGE_PAGE, V>(); }
+template <uint32_t V> constexpr auto usage() { return item<TAG_USAGE, V>(); }
+template <uint32_t V> constexpr auto usageMin() { return item<TAG_USAGE_MINIMUM, V>(); }
+template <uint32_t V> constexpr auto usageMax() { return item<TAG_USAGE_MAXIMUM, V>(); }
+template <int32_t V> constexpr auto logicalMin() { return signedItem<TAG_LOGICAL_MINIMUM, V>(); }
+template <int32_t V> constexpr auto logicalMax() { return signedItem<TAG_LOGICAL_MAXIMUM, V>(); }
+template <int32_t V> constexpr auto physicalMin() { return signedItem<TAG_PHYSICAL_MINIMUM, V>(); }
+template <int32_t V> constexpr auto physicalMax() { return signedItem<TAG_PHYSICAL_MAXIMUM, V>(); }
+template <uint32_t V> constexpr auto unit() { return item<TAG_UNIT, V>(); }
+template <uint32_t V> constexpr auto reportSize() { return item<TAG_REPORT_SIZE, V>(); }
+template <uint32_t V> constexpr auto reportCount() { return item<TAG_REPORT_COUNT, V>(); }
+template <uint8_t V> constexpr auto reportId() { return item<TAG_REPORT_ID, V>(); }
+template <uint8_t Flags> constexpr auto input() { return item<TAG_INPUT, Flags>(); }
+template <uint8_t Flags> constexpr auto output() { return item<TAG_OUTPUT, Flags>(); }
+template <uint8_t Flags> constexpr auto feature() { return item<TAG_FEATURE, Flags>(); }
+template <uint8_t Type> constexpr auto collection() { return item<TAG_COLLECTION, Type>(); }
+constexpr Bytes<1> endCollection() { return Bytes<1>{{TAG_END_COLLECTION}}; }
+
+template <size_t N>
+constexpr Bytes<N> join(const Bytes<N>& a)
+{
+  return a;
+}
+
+template <size_t N, typename... Rest>
+constexpr auto join(const Bytes<N>& a, const Rest&... rest)
+{
+  return a + join(rest...);
+}
+
+template <typename T>
+constexpr uint8_t indexOf()
+{
+  return 0;
+}
+
+template <typename T, typename First, typename... Rest>
+constexpr uint8_t indexOf()
+{
+  return std::is_same<T, First>::value ? 0 : 1 + indexOf<T, Rest...>();
+}
+
+// Device made of the given collections. Each collection type provides
+// `template <uint8_t Id> static constexpr auto build()`; IDs start at 1 in list order.
+template <typename... Collections>
+struct Descriptor
+{
+  template <typename T>
+  static constexpr uint8_t id()
+  {
+    static_assert(indexOf<T, Collections...>() < sizeof...(Collections), "collection is not part of the descriptor");
+    return indexOf<T, Collections...>() + 1;
+  }
+
+  static constexpr auto bytes()
+  {
+    return join(Collections::template build<id<Collections>()>()...);
+  }
+};
+
+// Sum of REPORT_SIZE * REPORT_COUNT over all main items with the given tag in one report
+template <size_t N>
+constexpr uint32_t reportBits(const Bytes<N>& d, uint8_t mainTag, uint8_t id)
+{
+  uint32_t bits = 0;
+  uint32_t size = 0;
+  uint32_t count = 0;
+  uint8_t current = 0;
+  size_t i = 0;
+  while (i < N) {
+    uint8_t prefix = d.data[i];
+    uint8_t length = prefix & 0x03;
+    if (length == 3) {
+      length = 4;
+    }
+    uint32_t value = 0;
+    for (uint8_t b = 0; b < length && i + 1 + b < N; b++) {
+      value |= (uint32_t)d.data[i + 1 + b] << (8 * b);
+    }
+    uint8_t tag = prefix & 0xFC;
+    if (tag == TAG_REPORT_SIZE) {
+      size = value;
+    } else if (tag == TAG_REPORT_COUNT) {
+      count = value;
+    } else if (tag == TAG_REPORT_ID) {
+      current = (uint8_t)value;
+    } else if (tag == mainTag && current == id) {
+      bits += size * count;
+    }
+    i += 1 + length;
+  }
+  return bits;
+}
+
+// Report length in bytes without the report ID, 0 if the bits do not fill whole bytes
+template <size_t N>
+constexpr uint32_t reportBytes(const Bytes<N>& d, uint8_t mainTag, uint8_t id)
+{
+  return reportBits(d, mainTag, id) % 8 == 0 ? reportBits(d, mainTag, id) / 8 : 0;
+}
+
+} // namespace hid
+
+#endif // HID_DESCRIPTOR_H
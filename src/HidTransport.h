@@ -0,0 +1,65 @@
+#ifndef HID_TRANSPORT_H
+#define HID_TRANSPORT_H
+
+#include <stdint.h>
+
+#define HID_MAX_REPORT_ID 8
+
+enum HidReportType : uint8_t
+{
+  HID_REPORT_INPUT,
+  HID_REPORT_OUTPUT,
+  HID_REPORT_FEATURE
+};
+
+enum HidSendResult : uint8_t
+{
+  HID_SEND_DONE,   // the link took the report
+  HID_SEND_RETRY,  // no buffer right now, try again later
+  HID_SEND_FAILED  // report is lost
+};
+
+// Connection parameters asked from the host, in BLE units: interval 1.25 ms,
+// supervision timeout 10 ms. Latency is the number of connection events the
+// device may skip while it has nothing to send.
+typedef struct
+{
+  uint16_t minInterval;
+  uint16_t maxInterval;
+  uint16_t latency;
+  uint16_t timeout;
+} HidLinkParams;
+
+// Events from a transport into the report layer. onSendComplete() may be
+// called from another task than the one that called send().
+class HidTransportListener
+{
+public:
+  virtual void onTransportConnect(void) = 0;
+  virtual void onTransportDisconnect(void) = 0;
+  // Parameters the link runs with, after connecting and after every change
+  virtual void onLinkParams(uint32_t intervalUs, uint16_t latency, uint32_t timeoutMs) = 0;
+  virtual void onSendComplete(HidSendResult result) = 0;
+
+protected:
+  ~HidTransportListener() {}
+};
+
+// Carries finished HID reports to the host. Reports are registered before
+// begin(); send() hands over one report and the transport answers it with
+// exactly one onSendComplete(), right away or later, unless the link drops.
+class HidTransport
+{
+public:
+  virtual ~HidTransport() {}
+  virtual void addReport(HidReportType type, uint8_t id, const uint8_t* initial = nullptr, uint8_t length = 0) = 0;
+  virtual void begin(const uint8_t* descriptor, uint16_t length, HidTransportListener* listener) = 0;
+  virtual void end(void) {}
+  virtual bool isConnected(void) = 0;
+  virtual void send(uint8_t id, const uint8_t* data, uint8_t length) = 0;
+  virtual void setBatteryLevel(uint8_t /*level*/) {}
+  // Asked for after every connect; the host decides, the result comes through onLinkParams()
+  virtual void requestLinkParams(const HidLinkParams& /*params*/) {}
+};
+
+#endif // HID_TRANSPORT_H
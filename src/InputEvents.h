@@ -0,0 +1,65 @@
+#ifndef INPUT_EVENTS_H
+#define INPUT_EVENTS_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Timestamped edge of a single input line
+typedef struct
+{
+  uint8_t pin;
+  uint8_t level;
+  int64_t timeUs;
+} InputEvent;
+
+// Lock-free ring buffer for exactly one producer (ISR) and one consumer (loop).
+// Only plain atomic loads/stores are used, the ESP32-C3 has no atomic RMW instructions.
+template <typename T, uint16_t N>
+class SpscRing
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+private:
+  T items[N];
+  std::atomic<uint16_t> head{0};
+  std::atomic<uint16_t> tail{0};
+  std::atomic<uint32_t> dropped{0};
+
+public:
+  inline __attribute__((always_inline)) bool push(const T& item)
+  {
+    uint16_t h = head.load(std::memory_order_relaxed);
+    uint16_t t = tail.load(std::memory_order_acquire);
+    if ((uint16_t)(h - t) >= N) {
+      dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    items[h & (N - 1)] = item;
+    head.store((uint16_t)(h + 1), std::memory_order_release);
+    return true;
+  }
+
+  inline bool pop(T& item)
+  {
+    uint16_t t = tail.load(std::memory_order_relaxed);
+    uint16_t h = head.load(std::memory_order_acquire);
+    if (h == t) {
+      return false;
+    }
+    item = items[t & (N - 1)];
+    tail.store((uint16_t)(t + 1), std::memory_order_release);
+    return true;
+  }
+
+  bool isEmpty(void) const
+  {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+  uint32_t droppedCount(void) const
+  {
+    return dropped.load(std::memory_order_relaxed);
+  }
+};
+
+#endif // INPUT_EVENTS_H
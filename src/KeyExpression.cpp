@@ -0,0 +1,136 @@
+#include "KeyExpression.h"
+#include <string.h>
+#include <strings.h>
+
+typedef struct
+{
+  const char* name;
+  uint8_t usage;
+  uint8_t modifier;
+} NamedKey;
+
+// Names are matched case-insensitively
+static const NamedKey NAMED_KEYS[] = {
+  {"CTRL", 0, 0x01}, {"CONTROL", 0, 0x01}, {"LCTRL", 0, 0x01},
+  {"SHIFT", 0, 0x02}, {"LSHIFT", 0, 0x02},
+  {"ALT", 0, 0x04}, {"LALT", 0, 0x04},
+  {"GUI", 0, 0x08}, {"WIN", 0, 0x08}, {"CMD", 0, 0x08}, {"META", 0, 0x08},
+  {"RCTRL", 0, 0x10}, {"RSHIFT", 0, 0x20}, {"RALT", 0, 0x40}, {"ALTGR", 0, 0x40}, {"RGUI", 0, 0x80},
+  {"ENTER", 0x28, 0}, {"RETURN", 0x28, 0}, {"ESC", 0x29, 0}, {"ESCAPE", 0x29, 0},
+  {"BACKSPACE", 0x2A, 0}, {"TAB", 0x2B, 0}, {"SPACE", 0x2C, 0}, {"PLUS", 0x2E, 0x02},
+  {"CAPS_LOCK", 0x39, 0},
+  {"F1", 0x3A, 0}, {"F2", 0x3B, 0}, {"F3", 0x3C, 0}, {"F4", 0x3D, 0},
+  {"F5", 0x3E, 0}, {"F6", 0x3F, 0}, {"F7", 0x40, 0}, {"F8", 0x41, 0},
+  {"F9", 0x42, 0}, {"F10", 0x43, 0}, {"F11", 0x44, 0}, {"F12", 0x45, 0},
+  {"F13", 0x68, 0}, {"F14", 0x69, 0}, {"F15", 0x6A, 0}, {"F16", 0x6B, 0},
+  {"F17", 0x6C, 0}, {"F18", 0x6D, 0}, {"F19", 0x6E, 0}, {"F20", 0x6F, 0},
+  {"F21", 0x70, 0}, {"F22", 0x71, 0}, {"F23", 0x72, 0}, {"F24", 0x73, 0},
+  {"PRTSC", 0x46, 0}, {"PRINT", 0x46, 0}, {"SCROLL_LOCK", 0x47, 0}, {"PAUSE", 0x48, 0},
+  {"INSERT", 0x49, 0}, {"HOME", 0x4A, 0}, {"PAGE_UP", 0x4B, 0}, {"DELETE", 0x4C, 0},
+  {"END", 0x4D, 0}, {"PAGE_DOWN", 0x4E, 0},
+  {"RIGHT", 0x4F, 0}, {"LEFT", 0x50, 0}, {"DOWN", 0x51, 0}, {"UP", 0x52, 0},
+  {"NUM_LOCK", 0x53, 0}, {"NUM_SLASH", 0x54, 0}, {"NUM_ASTERISK", 0x55, 0},
+  {"NUM_MINUS", 0x56, 0}, {"NUM_PLUS", 0x57, 0}, {"NUM_ENTER", 0x58, 0},
+  {"NUM_1", 0x59, 0}, {"NUM_2", 0x5A, 0}, {"NUM_3", 0x5B, 0}, {"NUM_4", 0x5C, 0},
+  {"NUM_5", 0x5D, 0}, {"NUM_6", 0x5E, 0}, {"NUM_7", 0x5F, 0}, {"NUM_8", 0x60, 0},
+  {"NUM_9", 0x61, 0}, {"NUM_0", 0x62, 0}, {"NUM_PERIOD", 0x63, 0},
+  {"MENU", 0x65, 0}, {"APP", 0x65, 0},
+};
+
+static bool addUsage(KeyReport& report, uint8_t usage)
+{
+  for (uint8_t i = 0; i < 6; i++) {
+    if (report.keys[i] == usage) {
+      return true;
+    }
+    if (report.keys[i] == 0) {
+      report.keys[i] = usage;
+      return true;
+    }
+  }
+  return false;
+}
+
+// One token of an expression. In combinations letters are taken case-insensitively
+// ("CTRL+U" is Ctrl+u), a lone character keeps its shift state ("A" is Shift+a).
+static bool compileToken(const char* token, size_t length, bool single, KeyReport& report)
+{
+  if (length == 1) {
+    char c = token[0];
+    if (!single && c >= 'A' && c <= 'Z') {
+      c = c - 'A' + 'a';
+    }
+    uint8_t modifiers = 0;
+    uint8_t usage = BleComboAbs::usageFromAscii((uint8_t)c, &modifiers);
+    if (usage == 0) {
+      return false;
+    }
+    report.modifiers |= modifiers;
+    return addUsage(report, usage);
+  }
+  for (size_t n = 0; n < sizeof(NAMED_KEYS) / sizeof(NAMED_KEYS[0]); n++) {
+    if (strlen(NAMED_KEYS[n].name) == length && strncasecmp(NAMED_KEYS[n].name, token, length) == 0) {
+      report.modifiers |= NAMED_KEYS[n].modifier;
+      return NAMED_KEYS[n].usage == 0 || addUsage(report, NAMED_KEYS[n].usage);
+    }
+  }
+  return false;
+}
+
+// Tokens are separated by '+'; an empty token stands for the '+' key itself ("CTRL++")
+static bool compileTokens(const char* text, KeyReport& report)
+{
+  size_t length = strlen(text);
+  if (length == 1) {
+    return compileToken(text, 1, true, report);
+  }
+  size_t start = 0;
+  while (start <= length) {
+    const char* sep = strchr(text + start, '+');
+    size_t end = sep ? (size_t)(sep - text) : length;
+    if (end == start) {
+      // "++" or a trailing '+': the plus key, which has to be followed by a
+      // separator or the end ("CTRL++A" is an error, not Ctrl+'+')
+      if (end < length && text[end + 1] != '+' && text[end + 1] != '\0') {
+        return false;
+      }
+      if (!compileToken("+", 1, false, report)) {
+        return false;
+      }
+      start = end + 2;
+      continue;
+    }
+    if (!compileToken(text + start, end - start, false, report)) {
+      return false;
+    }
+    start = end + 1;
+  }
+  return true;
+}
+
+// Returns false for unknown names, the report is then left empty
+bool KeyExpression::compile(const String& expression, KeyReport& report)
+{
+  memset(&report, 0, sizeof(KeyReport));
+  if (expression.length() == 0) {
+    return false;
+  }
+  if (!compileTokens(expression.c_str(), report)) {
+    memset(&report, 0, sizeof(KeyReport));
+    return false;
+  }
+  return true;
+}
+
+bool KeyExpression::isEmpty(const KeyReport& report)
+{
+  if (report.modifiers != 0) {
+    return false;
+  }
+  for (uint8_t i = 0; i < 6; i++) {
+    if (report.keys[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,16 @@
+#ifndef KEY_EXPRESSION_H
+#define KEY_EXPRESSION_H
+
+#include <Arduino.h>
+#include "BleComboAbs.h"
+
+// Compiles key expressions from the config ("a", "F5", "ENTER", "CTRL+SHIFT+U",
+// "NUM_3") once into a ready KeyReport with modifier bits and HID usages.
+class KeyExpression
+{
+public:
+  static bool compile(const String& expression, KeyReport& report);
+  static bool isEmpty(const KeyReport& report);
+};
+
+#endif // KEY_EXPRESSION_H
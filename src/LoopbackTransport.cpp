@@ -0,0 +1,237 @@
+#include "LoopbackTransport.h"
+#include <chrono>
+
+LoopbackTransport::LoopbackTransport(FILE* stream)
+    : out(stream) {}
+
+void LoopbackTransport::addReport(HidReportType type, uint8_t id, const uint8_t* initial, uint8_t length)
+{
+  if (id <= HID_MAX_REPORT_ID && type == HID_REPORT_INPUT) {
+    reports[id].input = true;
+  }
+}
+
+const char* LoopbackTransport::collectionName(uint16_t usagePage, uint16_t usage)
+{
+  if (usagePage == 0x01 && usage == 0x02) {
+    return "Mouse";
+  } else if (usagePage == 0x01 && usage == 0x05) {
+    return "Gamepad";
+  } else if (usagePage == 0x01 && usage == 0x06) {
+    return "Keyboard";
+  } else if (usagePage == 0x0D && usage == 0x02) {
+    return "Pen";
+  } else if (usagePage == 0x0D && usage == 0x04) {
+    return "TouchScreen";
+  }
+  return "Report";
+}
+
+// Collects the input fields of every report ID; only the items this
+// firmware's descriptors use are interpreted (no push/pop, no delimiters)
+void LoopbackTransport::parse(const uint8_t* d, uint16_t length)
+{
+  uint16_t usagePage = 0;
+  uint16_t firstUsage = 0;
+  bool haveUsage = false;
+  uint8_t reportSize = 0;
+  uint8_t reportCount = 0;
+  uint8_t id = 0;
+  uint8_t depth = 0;
+  const char* application = "Report";
+  uint16_t i = 0;
+  while (i < length) {
+    uint8_t prefix = d[i];
+    uint8_t size = prefix & 0x03;
+    if (size == 3) {
+      size = 4;
+    }
+    uint32_t value = 0;
+    for (uint8_t b = 0; b < size && i + 1 + b < length; b++) {
+      value |= (uint32_t)d[i + 1 + b] << (8 * b);
+    }
+    switch (prefix & 0xFC) {
+      case 0x04: usagePage = (uint16_t)value; break;
+      case 0x74: reportSize = (uint8_t)value; break;
+      case 0x94: reportCount = (uint8_t)value; break;
+      case 0x84:
+        id = (uint8_t)value;
+        if (id <= HID_MAX_REPORT_ID) {
+          reports[id].name = application;
+        }
+        break;
+      case 0x08:
+      case 0x18:
+        if (!haveUsage) {
+          firstUsage = (uint16_t)value;
+          haveUsage = true;
+        }
+        break;
+      case 0xA0:
+        if (depth == 0) {
+          application = collectionName(usagePage, firstUsage);
+        }
+        depth++;
+        haveUsage = false;
+        break;
+      case 0xC0:
+        if (depth > 0) {
+          depth--;
+        }
+        break;
+      case 0x80:
+        if (id <= HID_MAX_REPORT_ID && reports[id].fieldCount < LOOPBACK_MAX_FIELDS) {
+          Field& f = reports[id].fields[reports[id].fieldCount++];
+          f.usagePage = usagePage;
+          f.usage = haveUsage ? firstUsage : 0;
+          f.bits = reportSize;
+          f.count = reportCount;
+          f.constant = (value & 0x01) != 0;
+        }
+        haveUsage = false;
+        break;
+      case 0x90:
+      case 0xB0:
+        haveUsage = false;
+        break;
+    }
+    i += 1 + size;
+  }
+}
+
+void LoopbackTransport::begin(const uint8_t* descriptor, uint16_t length, HidTransportListener* l)
+{
+  listener = l;
+  parse(descriptor, length);
+  connected = true;
+  listener->onTransportConnect();
+  reportLink();
+  negotiate();
+}
+
+void LoopbackTransport::end(void)
+{
+  if (connected) {
+    connected = false;
+    listener->onTransportDisconnect();
+  }
+}
+
+bool LoopbackTransport::isConnected(void)
+{
+  return connected;
+}
+
+int64_t LoopbackTransport::steadyClockUs(void)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Time stamp source of the output lines, e.g. esp_timer_get_time to share the firmware's clock
+void LoopbackTransport::setClock(int64_t (*c)(void))
+{
+  clock = c;
+}
+
+int64_t LoopbackTransport::nowUs(void)
+{
+  return clock();
+}
+
+void LoopbackTransport::requestLinkParams(const HidLinkParams& params)
+{
+  linkRequest = params;
+  linkRequested = true;
+  if (connected) {
+    negotiate();
+  }
+}
+
+// Limits of the emulated host, in 1.25 ms units and connection events
+void LoopbackTransport::setHostLimits(uint16_t minInterval, uint16_t maxLatency)
+{
+  hostMinInterval = minInterval;
+  hostMaxLatency = maxLatency;
+}
+
+// Like a real host: the shortest interval both sides allow, latency capped, and
+// a request whose range lies entirely below the host's minimum is rejected
+void LoopbackTransport::negotiate(void)
+{
+  if (!linkRequested) {
+    return;
+  }
+  if (linkRequest.maxInterval < hostMinInterval) {
+    fprintf(out, "%lld link rejected interval=%u..%u\n", (long long)nowUs(), linkRequest.minInterval, linkRequest.maxInterval);
+    fflush(out);
+    return;
+  }
+  link.minInterval = linkRequest.minInterval > hostMinInterval ? linkRequest.minInterval : hostMinInterval;
+  link.maxInterval = link.minInterval;
+  link.latency = linkRequest.latency < hostMaxLatency ? linkRequest.latency : hostMaxLatency;
+  link.timeout = linkRequest.timeout;
+  reportLink();
+}
+
+void LoopbackTransport::reportLink(void)
+{
+  uint32_t intervalUs = (uint32_t)link.minInterval * 1250;
+  uint32_t timeoutMs = (uint32_t)link.timeout * 10;
+  fprintf(out, "%lld link interval_us=%u latency=%u timeout_ms=%u\n", (long long)nowUs(), (unsigned)intervalUs, link.latency,
+          (unsigned)timeoutMs);
+  fflush(out);
+  listener->onLinkParams(intervalUs, link.latency, timeoutMs);
+}
+
+uint32_t LoopbackTransport::sentCount(void)
+{
+  return sent;
+}
+
+uint32_t LoopbackTransport::readBits(const uint8_t* data, uint8_t length, uint32_t offset, uint8_t bits)
+{
+  uint32_t value = 0;
+  for (uint8_t b = 0; b < bits && b < 32; b++) {
+    uint32_t bit = offset + b;
+    if ((bit >> 3) < length && (data[bit >> 3] & (1 << (bit & 7)))) {
+      value |= (uint32_t)1 << b;
+    }
+  }
+  return value;
+}
+
+void LoopbackTransport::send(uint8_t id, const uint8_t* data, uint8_t length)
+{
+  if (id > HID_MAX_REPORT_ID || !reports[id].input) {
+    listener->onSendComplete(HID_SEND_FAILED);
+    return;
+  }
+  int64_t us = nowUs();
+  const Report& r = reports[id];
+  fprintf(out, "%lld id=%u %s", (long long)us, id, r.name != nullptr ? r.name : "Report");
+  uint32_t offset = 0;
+  for (uint8_t n = 0; n < r.fieldCount; n++) {
+    const Field& f = r.fields[n];
+    if (!f.constant) {
+      fprintf(out, " %02x:%02x=", f.usagePage, f.usage);
+      if (f.bits == 1) {
+        // Bit arrays (modifiers, buttons) as one hex mask
+        fprintf(out, "0x%x", (unsigned)readBits(data, length, offset, f.count > 32 ? 32 : f.count));
+        for (uint8_t chunk = 32; chunk < f.count; chunk += 32) {
+          uint8_t bits = f.count - chunk > 32 ? 32 : f.count - chunk;
+          fprintf(out, ",0x%x", (unsigned)readBits(data, length, offset + chunk, bits));
+        }
+      } else {
+        for (uint8_t c = 0; c < f.count; c++) {
+          fprintf(out, c == 0 ? "%u" : ",%u", (unsigned)readBits(data, length, offset + c * f.bits, f.bits));
+        }
+      }
+    }
+    offset += (uint32_t)f.bits * f.count;
+  }
+  fputc('\n', out);
+  fflush(out);
+  sent++;
+  listener->onSendComplete(HID_SEND_DONE);
+}
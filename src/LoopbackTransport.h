@@ -0,0 +1,76 @@
+#ifndef LOOPBACK_TRANSPORT_H
+#define LOOPBACK_TRANSPORT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "HidTransport.h"
+
+#define LOOPBACK_MAX_FIELDS 16
+#define LOOPBACK_HOST_INTERVAL 12  // 15 ms, what the emulated host picks on its own
+#define LOOPBACK_HOST_TIMEOUT 500  // 5 s
+
+// Transport without a radio: every report is decoded with the report
+// descriptor and written as one timestamped text line to a stream (file,
+// pipe or socket). Sends complete immediately, so the input path from a raw
+// edge to the report can run and be measured on a Linux host (test/host).
+//
+// Line format: <microseconds> id=<report id> <collection> <page>:<usage>=<values> ...
+//
+// Link parameters are negotiated with an emulated host that clamps requests to
+// its own limits (setHostLimits()); every outcome is written as
+// <microseconds> link interval_us=<n> latency=<n> timeout_ms=<n>
+class LoopbackTransport : public HidTransport
+{
+private:
+  typedef struct
+  {
+    uint16_t usagePage;
+    uint16_t usage;   // first usage of the field, 0 if none
+    uint8_t bits;     // per value
+    uint8_t count;
+    bool constant;
+  } Field;
+
+  typedef struct
+  {
+    const char* name;
+    Field fields[LOOPBACK_MAX_FIELDS];
+    uint8_t fieldCount;
+    bool input;
+  } Report;
+
+  FILE* out;
+  HidTransportListener* listener = nullptr;
+  Report reports[HID_MAX_REPORT_ID + 1] = {};
+  bool connected = false;
+  uint32_t sent = 0;
+  HidLinkParams link = {LOOPBACK_HOST_INTERVAL, LOOPBACK_HOST_INTERVAL, 0, LOOPBACK_HOST_TIMEOUT};
+  HidLinkParams linkRequest = {};
+  bool linkRequested = false;
+  uint16_t hostMinInterval = 6;
+  uint16_t hostMaxLatency = 499;
+  int64_t (*clock)(void) = steadyClockUs;
+
+  void parse(const uint8_t* descriptor, uint16_t length);
+  static const char* collectionName(uint16_t usagePage, uint16_t usage);
+  static uint32_t readBits(const uint8_t* data, uint8_t length, uint32_t offset, uint8_t bits);
+  static int64_t steadyClockUs(void);
+  int64_t nowUs(void);
+  void negotiate(void);
+  void reportLink(void);
+
+public:
+  explicit LoopbackTransport(FILE* out);
+
+  void addReport(HidReportType type, uint8_t id, const uint8_t* initial = nullptr, uint8_t length = 0) override;
+  void begin(const uint8_t* descriptor, uint16_t length, HidTransportListener* listener) override;
+  void end(void) override;
+  bool isConnected(void) override;
+  void send(uint8_t id, const uint8_t* data, uint8_t length) override;
+  void requestLinkParams(const HidLinkParams& params) override;
+  void setHostLimits(uint16_t minInterval, uint16_t maxLatency);
+  void setClock(int64_t (*clock)(void));
+  uint32_t sentCount(void);
+};
+
+#endif // LOOPBACK_TRANSPORT_H
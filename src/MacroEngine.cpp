@@ -0,0 +1,302 @@
+#include "MacroEngine.h"
+#include <string.h>
+
+MacroEngine::MacroEngine()
+{
+  for (uint8_t r = 0; r < MACRO_MAX_RUNNING; r++) {
+    runners[r].macro = MACRO_NONE;
+  }
+}
+
+// Macros can be defined before begin(), they only run afterwards
+void MacroEngine::begin(BleComboAbs* combo, Scheduler* sched)
+{
+  hid = combo;
+  scheduler = sched;
+  timer = scheduler->create(onTimer, this);
+}
+
+void MacroEngine::setDebug(bool enabled)
+{
+  debugEnabled = enabled;
+}
+
+void MacroEngine::onTimer(void* arg)
+{
+  MacroEngine* engine = (MacroEngine*)arg;
+  engine->run(millis());
+}
+
+void MacroEngine::clear(void)
+{
+  cancelAll();
+  macroCount = 0;
+  stepCount = 0;
+}
+
+// Starts a new macro definition, following addStep() calls append to it
+int8_t MacroEngine::define(const String& macroName, uint16_t gap)
+{
+  if (macroCount >= MACRO_MAX_MACROS) {
+    return MACRO_NONE;
+  }
+  Macro& m = macros[macroCount];
+  m.first = stepCount;
+  m.count = 0;
+  m.gap = gap;
+  names[macroCount] = macroName;
+  return macroCount++;
+}
+
+bool MacroEngine::addStep(const MacroStep& step)
+{
+  if (macroCount == 0 || stepCount >= MACRO_MAX_STEPS) {
+    return false;
+  }
+  steps[stepCount++] = step;
+  macros[macroCount - 1].count++;
+  return true;
+}
+
+int8_t MacroEngine::find(const String& macroName)
+{
+  for (uint8_t m = 0; m < macroCount; m++) {
+    if (names[m] == macroName) {
+      return m;
+    }
+  }
+  return MACRO_NONE;
+}
+
+const String& MacroEngine::name(int8_t macro)
+{
+  return names[macro];
+}
+
+bool MacroEngine::isRunning(int8_t macro)
+{
+  for (uint8_t r = 0; r < MACRO_MAX_RUNNING; r++) {
+    if (runners[r].macro == macro) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool MacroEngine::start(int8_t macro, uint32_t now)
+{
+  if (hid == nullptr || macro < 0 || macro >= macroCount) {
+    return false;
+  }
+  for (uint8_t r = 0; r < MACRO_MAX_RUNNING; r++) {
+    Runner& runner = runners[r];
+    if (runner.macro == MACRO_NONE) {
+      runner.macro = macro;
+      runner.step = 0;
+      runner.secondPhase = false;
+      runner.due = now;
+      runner.started = now;
+      runner.maxLate = 0;
+      memset(&runner.held, 0, sizeof(KeyReport));
+      runner.absHeld = false;
+      run(now);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Stops a running macro and lets go of everything it still holds
+bool MacroEngine::cancel(int8_t macro)
+{
+  bool found = false;
+  uint32_t now = millis();
+  for (uint8_t r = 0; r < MACRO_MAX_RUNNING; r++) {
+    if (runners[r].macro != MACRO_NONE && runners[r].macro == macro) {
+      finish(runners[r], now, true);
+      found = true;
+    }
+  }
+  rearm();
+  return found;
+}
+
+void MacroEngine::cancelAll(void)
+{
+  uint32_t now = millis();
+  for (uint8_t r = 0; r < MACRO_MAX_RUNNING; r++) {
+    if (runners[r].macro != MACRO_NONE) {
+      finish(runners[r], now, true);
+    }
+  }
+  rearm();
+}
+
+void MacroEngine::finish(Runner& runner, uint32_t now, bool cancelled)
+{
+  if (cancelled) {
+    hid->releaseReport(runner.held);
+    if (runner.absHeld) {
+      hid->releaseAbs();
+    }
+  }
+  if (debugEnabled) {
+    Serial.print("[DEBUG] Macro '");
+    Serial.print(names[runner.macro]);
+    Serial.print(cancelled ? "' cancelled after " : "' done after ");
+    Serial.print(now - runner.started);
+    Serial.print(" ms, max step delay ");
+    Serial.print(runner.maxLate);
+    Serial.println(" ms");
+  }
+  runner.macro = MACRO_NONE;
+}
+
+static void removeKeys(KeyReport& held, const KeyReport& report)
+{
+  held.modifiers &= ~report.modifiers;
+  for (uint8_t i = 0; i < 6; i++) {
+    for (uint8_t j = 0; j < 6; j++) {
+      if (report.keys[j] != 0 && held.keys[i] == report.keys[j]) {
+        held.keys[i] = 0;
+      }
+    }
+  }
+}
+
+static void addKeys(KeyReport& held, const KeyReport& report)
+{
+  held.modifiers |= report.modifiers;
+  for (uint8_t j = 0; j < 6; j++) {
+    if (report.keys[j] == 0) {
+      continue;
+    }
+    uint8_t free = 6;
+    bool present = false;
+    for (uint8_t i = 0; i < 6; i++) {
+      if (held.keys[i] == report.keys[j]) {
+        present = true;
+      } else if (held.keys[i] == 0 && free == 6) {
+        free = i;
+      }
+    }
+    if (!present && free < 6) {
+      held.keys[free] = report.keys[j];
+    }
+  }
+}
+
+// Executes all steps of one run that are due. Step times are planned from the
+// previous plan, not from the actual time, so a late tick does not shift the rest.
+void MacroEngine::advance(Runner& runner, uint32_t now)
+{
+  const Macro& m = macros[runner.macro];
+  while (runner.step < m.count) {
+    if ((int32_t)(now - runner.due) < 0) {
+      return;
+    }
+    uint32_t late = now - runner.due;
+    if (late > runner.maxLate) {
+      runner.maxLate = late;
+    }
+    if (debugEnabled) {
+      Serial.print("[DEBUG] Macro '");
+      Serial.print(names[runner.macro]);
+      Serial.print("' step ");
+      Serial.print(runner.step);
+      Serial.print(runner.secondPhase ? " (release)" : "");
+      Serial.print(" at +");
+      Serial.print(now - runner.started);
+      Serial.print(" ms, late ");
+      Serial.print(late);
+      Serial.println(" ms");
+    }
+    const MacroStep& step = steps[m.first + runner.step];
+    uint32_t next = m.gap;
+    switch (step.type) {
+      case MACRO_STEP_KEY_DOWN:
+        hid->pressReport(step.report);
+        addKeys(runner.held, step.report);
+        break;
+      case MACRO_STEP_KEY_UP:
+        hid->releaseReport(step.report);
+        removeKeys(runner.held, step.report);
+        break;
+      case MACRO_STEP_KEY_TAP:
+        if (!runner.secondPhase) {
+          hid->pressReport(step.report);
+          addKeys(runner.held, step.report);
+          runner.secondPhase = true;
+          runner.due += step.ms;
+          continue;
+        }
+        hid->releaseReport(step.report);
+        removeKeys(runner.held, step.report);
+        runner.secondPhase = false;
+        // With "gap": 0 the next tap would be pressed in the same call ("ll" in a text step)
+        if (next < MACRO_MIN_TAP_GAP_MS) {
+          next = MACRO_MIN_TAP_GAP_MS;
+        }
+        break;
+      case MACRO_STEP_ABS_MOVE:
+        hid->moveAbs(step.x, step.y);
+        runner.absHeld = true;
+        break;
+      case MACRO_STEP_ABS_RELEASE:
+        hid->releaseAbs();
+        runner.absHeld = false;
+        break;
+      case MACRO_STEP_ABS_TAP:
+        if (!runner.secondPhase) {
+          hid->moveAbs(step.x, step.y);
+          runner.absHeld = true;
+          runner.secondPhase = true;
+          runner.due += step.ms;
+          continue;
+        }
+        hid->releaseAbs();
+        runner.absHeld = false;
+        runner.secondPhase = false;
+        break;
+      case MACRO_STEP_WAIT:
+        next = step.ms;
+        break;
+    }
+    runner.step++;
+    runner.due += next;
+  }
+  finish(runner, now, false);
+}
+
+void MacroEngine::run(uint32_t now)
+{
+  for (uint8_t r = 0; r < MACRO_MAX_RUNNING; r++) {
+    if (runners[r].macro != MACRO_NONE) {
+      advance(runners[r], now);
+    }
+  }
+  rearm();
+}
+
+void MacroEngine::rearm(void)
+{
+  if (scheduler == nullptr) {
+    return;
+  }
+  bool any = false;
+  uint32_t earliest = 0;
+  for (uint8_t r = 0; r < MACRO_MAX_RUNNING; r++) {
+    if (runners[r].macro == MACRO_NONE) {
+      continue;
+    }
+    if (!any || (int32_t)(runners[r].due - earliest) < 0) {
+      earliest = runners[r].due;
+      any = true;
+    }
+  }
+  if (any) {
+    scheduler->arm(timer, earliest);
+  } else {
+    scheduler->stop(timer);
+  }
+}
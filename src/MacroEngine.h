@@ -0,0 +1,91 @@
+#ifndef MACRO_ENGINE_H
+#define MACRO_ENGINE_H
+
+#include <Arduino.h>
+#include "BleComboAbs.h"
+#include "Scheduler.h"
+
+#define MACRO_MAX_MACROS 16
+#define MACRO_MAX_STEPS 256
+#define MACRO_MAX_RUNNING 4
+#define MACRO_NONE -1
+#define MACRO_MIN_TAP_GAP_MS 1 // after a tap's release, so the next press is a tick later
+
+enum MacroStepType : uint8_t
+{
+  MACRO_STEP_KEY_DOWN,
+  MACRO_STEP_KEY_UP,
+  MACRO_STEP_KEY_TAP,   // down, `ms` hold, up
+  MACRO_STEP_ABS_MOVE,
+  MACRO_STEP_ABS_RELEASE,
+  MACRO_STEP_ABS_TAP,   // move with tip down, `ms` hold, release
+  MACRO_STEP_WAIT
+};
+
+typedef struct
+{
+  MacroStepType type;
+  uint16_t ms;
+  int16_t x;
+  int16_t y;
+  KeyReport report;
+} MacroStep;
+
+// Runs config-defined key/touch sequences step by step from a scheduler timer.
+// Several macros can run at the same time; loop() never waits for a step.
+class MacroEngine
+{
+private:
+  typedef struct
+  {
+    uint16_t first;
+    uint16_t count;
+    uint16_t gap; // pause after each step in ms
+  } Macro;
+
+  typedef struct
+  {
+    int8_t macro;
+    uint16_t step;
+    bool secondPhase; // tap steps: press done, release pending
+    uint32_t due;     // planned time of the next step
+    uint32_t started;
+    uint32_t maxLate;
+    KeyReport held;   // keys pressed by this run, released on cancel
+    bool absHeld;
+  } Runner;
+
+  BleComboAbs* hid = nullptr;
+  Scheduler* scheduler = nullptr;
+  TimerId timer = SCHEDULER_NO_TIMER;
+  Macro macros[MACRO_MAX_MACROS];
+  String names[MACRO_MAX_MACROS];
+  uint8_t macroCount = 0;
+  MacroStep steps[MACRO_MAX_STEPS];
+  uint16_t stepCount = 0;
+  Runner runners[MACRO_MAX_RUNNING];
+  bool debugEnabled = false;
+
+  void advance(Runner& runner, uint32_t now);
+  void finish(Runner& runner, uint32_t now, bool cancelled);
+  void rearm(void);
+  static void onTimer(void* arg);
+
+public:
+  MacroEngine();
+  void begin(BleComboAbs* hid, Scheduler* scheduler);
+  void setDebug(bool enabled);
+  void clear(void);
+  int8_t define(const String& name, uint16_t gap);
+  bool addStep(const MacroStep& step);
+  int8_t find(const String& name);
+  const String& name(int8_t macro);
+
+  bool start(int8_t macro, uint32_t now);
+  bool cancel(int8_t macro);
+  void cancelAll(void);
+  bool isRunning(int8_t macro);
+  void run(uint32_t now);
+};
+
+#endif // MACRO_ENGINE_H
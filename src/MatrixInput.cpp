@@ -0,0 +1,111 @@
+#include "MatrixInput.h"
+
+bool MatrixInput::begin(GpioInput* gpioInput, const uint8_t* rowPins, uint8_t rowNum, const uint8_t* colPins, uint8_t colNum)
+{
+  if (rowNum == 0 || colNum == 0 || rowNum > MATRIX_MAX_ROWS || colNum > MATRIX_MAX_COLS) {
+    return false;
+  }
+  gpio = gpioInput;
+  rowCount = rowNum;
+  colCount = colNum;
+  colMask = 0;
+  for (uint8_t r = 0; r < rowCount; r++) {
+    rows[r] = rowPins[r];
+    pinMode(rows[r], OUTPUT_OPEN_DRAIN);
+    digitalWrite(rows[r], HIGH);
+  }
+  for (uint8_t c = 0; c < colCount; c++) {
+    cols[c] = colPins[c];
+    pinMode(cols[c], INPUT_PULLUP);
+    colMask |= (uint64_t)1 << cols[c];
+  }
+  state = 0;
+  idle = false;
+  return true;
+}
+
+bool MatrixInput::isConfigured(void)
+{
+  return rowCount > 0 && colCount > 0;
+}
+
+uint8_t MatrixInput::keyCount(void)
+{
+  return rowCount * colCount;
+}
+
+uint8_t MatrixInput::keyIndex(uint8_t row, uint8_t col)
+{
+  return row * colCount + col;
+}
+
+bool MatrixInput::isColumn(uint8_t pin)
+{
+  return pin < 64 && (colMask & ((uint64_t)1 << pin)) != 0;
+}
+
+void MatrixInput::driveAllRows(uint8_t level)
+{
+  for (uint8_t r = 0; r < rowCount; r++) {
+    digitalWrite(rows[r], level);
+  }
+}
+
+// Scans all rows, the columns of a row are read with one register access.
+// Returns the keys that changed, `pressed` receives the current key bitmap.
+uint64_t MatrixInput::scan(uint64_t& pressed)
+{
+  uint64_t next = 0;
+  for (uint8_t r = 0; r < rowCount; r++) {
+    digitalWrite(rows[r], LOW);
+    delayMicroseconds(MATRIX_SETTLE_US);
+    uint64_t levels = GpioInput::readAll();
+    digitalWrite(rows[r], HIGH);
+    for (uint8_t c = 0; c < colCount; c++) {
+      if (!((levels >> cols[c]) & 0x1)) {
+        next |= (uint64_t)1 << keyIndex(r, c);
+      }
+    }
+  }
+  uint64_t changed = next ^ state;
+  state = next;
+  pressed = next;
+  return changed;
+}
+
+// All rows low: any key press pulls its column low and raises an interrupt.
+// Returns false if a key went down while arming, the caller keeps scanning then.
+bool MatrixInput::enterIdle(void)
+{
+  if (idle || !isConfigured()) {
+    return idle;
+  }
+  driveAllRows(LOW);
+  for (uint8_t c = 0; c < colCount; c++) {
+    gpio->attach(cols[c]);
+  }
+  idle = true;
+  delayMicroseconds(MATRIX_SETTLE_US);
+  if ((GpioInput::readAll() & colMask) != colMask) {
+    leaveIdle();
+    return false;
+  }
+  return true;
+}
+
+void MatrixInput::leaveIdle(void)
+{
+  if (!idle) {
+    return;
+  }
+  for (uint8_t c = 0; c < colCount; c++) {
+    gpio->detach(cols[c]);
+  }
+  driveAllRows(HIGH);
+  idle = false;
+}
+
+bool MatrixInput::isIdle(void)
+{
+  return idle;
+}
@@ -0,0 +1,42 @@
+#ifndef MATRIX_INPUT_H
+#define MATRIX_INPUT_H
+
+#include <Arduino.h>
+#include "GpioInput.h"
+
+#define MATRIX_MAX_ROWS 8
+#define MATRIX_MAX_COLS 8
+#define MATRIX_MAX_KEYS (MATRIX_MAX_ROWS * MATRIX_MAX_COLS)
+#define MATRIX_SETTLE_US 3
+
+// Key matrix with open-drain row drivers and pulled-up columns.
+// While keys are active it is scanned at full rate; when idle all rows are
+// driven low and the columns are armed as edge interrupts instead.
+class MatrixInput
+{
+private:
+  GpioInput* gpio = nullptr;
+  uint8_t rows[MATRIX_MAX_ROWS];
+  uint8_t cols[MATRIX_MAX_COLS];
+  uint8_t rowCount = 0;
+  uint8_t colCount = 0;
+  uint64_t colMask = 0;
+  uint64_t state = 0; // bit (row * colCount + col) set while the key is pressed
+  bool idle = false;
+
+  void driveAllRows(uint8_t level);
+
+public:
+  bool begin(GpioInput* gpio, const uint8_t* rowPins, uint8_t rows, const uint8_t* colPins, uint8_t cols);
+  bool isConfigured(void);
+  uint8_t keyCount(void);
+  uint8_t keyIndex(uint8_t row, uint8_t col);
+  bool isColumn(uint8_t pin);
+
+  uint64_t scan(uint64_t& pressed);
+  bool enterIdle(void);
+  void leaveIdle(void);
+  bool isIdle(void);
+};
+
+#endif // MATRIX_INPUT_H
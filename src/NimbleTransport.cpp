@@ -0,0 +1,339 @@
+#include "NimbleTransport.h"
+
+#if defined(CONFIG_BT_ENABLED)
+
+#if defined(USE_NIMBLE)
+#include <NimBLEDevice.h>
+#include <NimBLEServer.h>
+#include <NimBLEUtils.h>
+#include <NimBLEHIDDevice.h>
+#else
+#include <BLEDevice.h>
+#include <BLEUtils.h>
+#include <BLEServer.h>
+#include "BLE2902.h"
+#include "BLEHIDDevice.h"
+#endif // USE_NIMBLE
+
+#include <Arduino.h>
+#include <string.h>
+
+#if defined(CONFIG_ARDUHAL_ESP_LOG)
+  #include "esp32-hal-log.h"
+  #define LOG_TAG ""
+#else
+  #include "esp_log.h"
+  static const char* LOG_TAG = "BLEDevice";
+#endif
+
+#if defined(USE_NIMBLE)
+NimbleTransport* NimbleTransport::active = nullptr;
+#endif
+
+NimbleTransport::NimbleTransport(std::string deviceName, std::string deviceManufacturer, uint8_t batteryLevel)
+    : deviceName(std::string(deviceName).substr(0, 15))
+    , deviceManufacturer(std::string(deviceManufacturer).substr(0, 15))
+    , batteryLevel(batteryLevel) {}
+
+void NimbleTransport::setName(std::string deviceName)
+{
+  this->deviceName = deviceName;
+}
+
+void NimbleTransport::setAdvertising(const AdvertisingPolicy& policy)
+{
+  this->policy = policy;
+}
+
+AdvertisingPhase NimbleTransport::advertisingPhase(void)
+{
+  return phase;
+}
+
+// Advertising interval in units of 0.625 ms, within the 20 ms .. 10.24 s the spec allows
+static uint16_t advertisingUnits(uint16_t ms)
+{
+  uint32_t units = (uint32_t)ms * 8 / 5;
+  if (units < 0x20) {
+    return 0x20;
+  }
+  if (units > 0x4000) {
+    return 0x4000;
+  }
+  return (uint16_t)units;
+}
+
+// Starts the given phase; with NimBLE each timed phase ends in onAdvertisingComplete()
+// which moves on to the next one
+void NimbleTransport::startAdvertising(AdvertisingPhase next)
+{
+#if defined(USE_NIMBLE)
+  if (next == ADV_DIRECTED && !(policy.directed && hasPeer)) {
+    next = ADV_FAST;
+  }
+  if (next == ADV_FAST && policy.fastTimeS == 0) {
+    next = ADV_SLOW;
+  }
+#else
+  // Bluedroid cannot time out advertising, it stays in the fast phase
+  next = ADV_FAST;
+#endif
+  phase = next;
+  uint16_t interval = next == ADV_SLOW ? policy.slowIntervalMs : policy.fastIntervalMs;
+  advertising->setMinInterval(advertisingUnits(interval));
+  advertising->setMaxInterval(advertisingUnits(interval + interval / 2));
+#if defined(USE_NIMBLE)
+  active = this;
+  if (advertising->isAdvertising()) {
+    advertising->stop();
+  }
+  ESP_LOGI(LOG_TAG, "advertising phase %d, interval %d ms", next, interval);
+  if (next == ADV_DIRECTED) {
+    uint32_t seconds = policy.fastTimeS < ADV_DIRECTED_TIME_S ? policy.fastTimeS : ADV_DIRECTED_TIME_S;
+    advertising->setAdvertisementType(BLE_GAP_CONN_MODE_DIR);
+    if (advertising->start(seconds, onAdvertisingComplete, &lastPeer)) {
+      return;
+    }
+    // Peer address not usable for directed advertising
+    hasPeer = false;
+    startAdvertising(ADV_FAST);
+    return;
+  }
+  advertising->setAdvertisementType(BLE_GAP_CONN_MODE_UND);
+  // NimBLE 1.4 takes the duration in seconds, 0 advertises until a host connects
+  advertising->start(next == ADV_FAST ? policy.fastTimeS : 0, onAdvertisingComplete);
+#else
+  advertising->start();
+#endif
+}
+
+#if defined(USE_NIMBLE)
+// Called by the NimBLE host when a timed phase ran out without a connection
+void NimbleTransport::onAdvertisingComplete(NimBLEAdvertising* pAdvertising)
+{
+  NimbleTransport* self = active;
+  // Advertising also ends when a host connects, possibly before onConnect() ran
+  if (self == nullptr || self->connected || NimBLEDevice::getServer()->getConnectedCount() > 0) {
+    return;
+  }
+  if (self->phase == ADV_DIRECTED) {
+    self->startAdvertising(ADV_FAST);
+  } else if (self->phase == ADV_FAST) {
+    self->startAdvertising(ADV_SLOW);
+  }
+}
+#endif
+
+void NimbleTransport::addReport(HidReportType type, uint8_t id, const uint8_t* initial, uint8_t length)
+{
+  if (id > HID_MAX_REPORT_ID) {
+    return;
+  }
+  reportTypes[id][type] = true;
+  if (type == HID_REPORT_FEATURE && initial != nullptr) {
+    featureLengths[id] = length < sizeof(featureValues[id]) ? length : sizeof(featureValues[id]);
+    memcpy(featureValues[id], initial, featureLengths[id]);
+  }
+}
+
+void NimbleTransport::begin(const uint8_t* descriptor, uint16_t length, HidTransportListener* l)
+{
+  listener = l;
+  BLEDevice::init(deviceName);
+  BLEServer* pServer = BLEDevice::createServer();
+  pServer->setCallbacks(this);
+#if defined(USE_NIMBLE)
+  // Advertising after a disconnect follows the policy, see startAdvertising()
+  pServer->advertiseOnDisconnect(false);
+  // Parameter changes by the host only show up as GAP events
+  ble_gap_event_listener_register(&gapListener, onGapEvent, this);
+  int bonds = NimBLEDevice::getNumBonds();
+  if (bonds > 0) {
+    // The bond store drops the oldest entry first, the last one is the newest host
+    lastPeer = NimBLEDevice::getBondedAddress(bonds - 1);
+    hasPeer = true;
+  }
+#endif
+
+  hid = new BLEHIDDevice(pServer);
+  for (uint8_t id = 1; id <= HID_MAX_REPORT_ID; id++) {
+    if (reportTypes[id][HID_REPORT_INPUT]) {
+      inputs[id] = hid->inputReport(id);
+#if defined(USE_NIMBLE)
+      // Notify status drives the report pacing
+      inputs[id]->setCallbacks(this);
+#endif
+    }
+    if (reportTypes[id][HID_REPORT_OUTPUT]) {
+      outputs[id] = hid->outputReport(id);
+      outputs[id]->setCallbacks(this);
+    }
+    if (reportTypes[id][HID_REPORT_FEATURE]) {
+      features[id] = hid->featureReport(id);
+      features[id]->setValue(featureValues[id], featureLengths[id]);
+    }
+  }
+  loopTask = xTaskGetCurrentTaskHandle();
+
+  hid->manufacturer()->setValue(deviceManufacturer);
+  hid->pnp(0x02, 0x05ac, 0x820a, 0x0210);
+  hid->hidInfo(0x00, 0x01);
+
+#if defined(USE_NIMBLE)
+  BLEDevice::setSecurityAuth(true, true, true);
+#else
+  BLESecurity* pSecurity = new BLESecurity();
+  pSecurity->setAuthenticationMode(ESP_LE_AUTH_REQ_SC_MITM_BOND);
+#endif // USE_NIMBLE
+
+  hid->reportMap((uint8_t*)descriptor, length);
+  hid->startServices();
+
+  advertising = pServer->getAdvertising();
+  advertising->setAppearance(HID_KEYBOARD);
+  advertising->addServiceUUID(hid->hidService()->getUUID());
+  advertising->addServiceUUID(BLEUUID((uint16_t)0x180F));
+  advertising->setScanResponse(false);
+  startAdvertising(ADV_DIRECTED);
+  hid->setBatteryLevel(batteryLevel);
+
+  ESP_LOGD(LOG_TAG, "Advertising started!");
+}
+
+bool NimbleTransport::isConnected(void)
+{
+  return this->connected;
+}
+
+void NimbleTransport::setBatteryLevel(uint8_t level)
+{
+  this->batteryLevel = level;
+  if (hid != nullptr) {
+    this->hid->setBatteryLevel(this->batteryLevel);
+  }
+}
+
+void NimbleTransport::send(uint8_t id, const uint8_t* data, uint8_t length)
+{
+  BLECharacteristic* characteristic = id <= HID_MAX_REPORT_ID ? inputs[id] : nullptr;
+  if (characteristic == nullptr) {
+    listener->onSendComplete(HID_SEND_FAILED);
+    return;
+  }
+  sending = characteristic;
+  characteristic->setValue(data, length);
+  characteristic->notify();
+#if !defined(USE_NIMBLE)
+  listener->onSendComplete(HID_SEND_DONE);
+#endif
+}
+
+void NimbleTransport::requestLinkParams(const HidLinkParams& params)
+{
+  linkRequest = params;
+  linkRequested = true;
+}
+
+void NimbleTransport::setNotifications(bool enabled)
+{
+#if !defined(USE_NIMBLE)
+  for (uint8_t id = 1; id <= HID_MAX_REPORT_ID; id++) {
+    if (inputs[id] != nullptr) {
+      BLE2902* desc = (BLE2902*)inputs[id]->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
+      desc->setNotifications(enabled);
+    }
+  }
+#else
+  (void)enabled;
+#endif
+}
+
+void NimbleTransport::onConnect(BLEServer* pServer)
+{
+  this->connected = true;
+  phase = ADV_OFF;
+
+  if (hid != nullptr) {
+    hid->setBatteryLevel(batteryLevel);
+  }
+  setNotifications(true);
+  listener->onTransportConnect();
+}
+
+void NimbleTransport::onDisconnect(BLEServer* pServer)
+{
+  this->connected = false;
+  setNotifications(false);
+  listener->onTransportDisconnect();
+  startAdvertising(ADV_DIRECTED);
+}
+
+#if defined(USE_NIMBLE)
+void NimbleTransport::onConnect(BLEServer* pServer, ble_gap_conn_desc* desc)
+{
+  // Interval in units of 1.25 ms, supervision timeout in units of 10 ms
+  listener->onLinkParams((uint32_t)desc->conn_itvl * 1250, desc->conn_latency, (uint32_t)desc->supervision_timeout * 10);
+  lastPeer = NimBLEAddress(desc->peer_id_addr);
+  hasPeer = true;
+}
+
+// The host sets up HID (bonding, encryption, its own parameter choice) right after
+// connecting; asking for the profile once the link is encrypted keeps it from being
+// overwritten by that. The host may still grant something else.
+void NimbleTransport::onAuthenticationComplete(ble_gap_conn_desc* desc)
+{
+  if (!linkRequested || !desc->sec_state.encrypted) {
+    return;
+  }
+  ESP_LOGI(LOG_TAG, "requesting interval %d..%d, latency %d, timeout %d", linkRequest.minInterval, linkRequest.maxInterval,
+           linkRequest.latency, linkRequest.timeout);
+  NimBLEDevice::getServer()->updateConnParams(desc->conn_handle, linkRequest.minInterval, linkRequest.maxInterval,
+                                              linkRequest.latency, linkRequest.timeout);
+}
+
+// Reports the parameters after every successful update, from the NimBLE host task
+int NimbleTransport::onGapEvent(ble_gap_event* event, void* arg)
+{
+  NimbleTransport* self = (NimbleTransport*)arg;
+  if (event->type != BLE_GAP_EVENT_CONN_UPDATE || event->conn_update.status != 0) {
+    return 0;
+  }
+  ble_gap_conn_desc desc;
+  if (ble_gap_conn_find(event->conn_update.conn_handle, &desc) != 0) {
+    return 0;
+  }
+  ESP_LOGI(LOG_TAG, "link parameters: interval %d, latency %d, timeout %d", desc.conn_itvl, desc.conn_latency,
+           desc.supervision_timeout);
+  self->listener->onLinkParams((uint32_t)desc.conn_itvl * 1250, desc.conn_latency, (uint32_t)desc.supervision_timeout * 10);
+  return 0;
+}
+
+// Called by the NimBLE host for every notify, possibly from its own task
+void NimbleTransport::onStatus(NimBLECharacteristic* pCharacteristic, Status s, int code)
+{
+  if (pCharacteristic != sending) {
+    return;
+  }
+  HidSendResult result;
+  if (s == SUCCESS_NOTIFY) {
+    result = HID_SEND_DONE;
+  } else if (code == BLE_HS_ENOMEM || code == BLE_HS_EBUSY || code == BLE_HS_EAGAIN) {
+    result = HID_SEND_RETRY;
+  } else {
+    result = HID_SEND_FAILED;
+  }
+  listener->onSendComplete(result);
+  if (loopTask != nullptr && xTaskGetCurrentTaskHandle() != loopTask) {
+    xTaskNotifyGive(loopTask);
+  }
+}
+#endif
+
+void NimbleTransport::onWrite(BLECharacteristic* me)
+{
+  uint8_t* value = (uint8_t*)(me->getValue().c_str());
+  (void)value;
+  ESP_LOGI(LOG_TAG, "keyboard LED update: %d", *value);
+}
+
+#endif // CONFIG_BT_ENABLED
@@ -0,0 +1,117 @@
+#ifndef NIMBLE_TRANSPORT_H
+#define NIMBLE_TRANSPORT_H
+
+#include "sdkconfig.h"
+#include <stdint.h>
+
+#define ADV_FAST_INTERVAL_MS 20
+#define ADV_FAST_TIME_S 30
+#define ADV_SLOW_INTERVAL_MS 1000
+#define ADV_DIRECTED_TIME_S 3
+
+// Advertising while nobody is connected: a burst of fast advertising after boot
+// and after every disconnect (optionally directed to the last bonded host for
+// the first ADV_DIRECTED_TIME_S seconds), then slow advertising to save power.
+typedef struct
+{
+  uint16_t fastIntervalMs;
+  uint16_t fastTimeS;
+  uint16_t slowIntervalMs;
+  bool directed;
+} AdvertisingPolicy;
+
+#if defined(CONFIG_BT_ENABLED)
+
+#if defined(USE_NIMBLE)
+#include <NimBLECharacteristic.h>
+#include <NimBLEHIDDevice.h>
+
+#define BLEDevice                  NimBLEDevice
+#define BLEServerCallbacks         NimBLEServerCallbacks
+#define BLECharacteristicCallbacks NimBLECharacteristicCallbacks
+#define BLEHIDDevice               NimBLEHIDDevice
+#define BLECharacteristic          NimBLECharacteristic
+#define BLEAdvertising             NimBLEAdvertising
+#define BLEServer                  NimBLEServer
+
+#else
+#include <BLEHIDDevice.h>
+#include <BLECharacteristic.h>
+#endif // USE_NIMBLE
+
+#include <string>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "HidTransport.h"
+
+enum AdvertisingPhase : uint8_t
+{
+  ADV_OFF,
+  ADV_DIRECTED,
+  ADV_FAST,
+  ADV_SLOW
+};
+
+// HID over GATT: one characteristic per report, notify status from the host
+// stack completes each send
+class NimbleTransport : public HidTransport, public BLEServerCallbacks, public BLECharacteristicCallbacks
+{
+private:
+  BLEHIDDevice* hid = nullptr;
+  BLEAdvertising* advertising = nullptr;
+  BLECharacteristic* inputs[HID_MAX_REPORT_ID + 1] = {};
+  BLECharacteristic* outputs[HID_MAX_REPORT_ID + 1] = {};
+  BLECharacteristic* features[HID_MAX_REPORT_ID + 1] = {};
+  uint8_t featureValues[HID_MAX_REPORT_ID + 1][8] = {};
+  uint8_t featureLengths[HID_MAX_REPORT_ID + 1] = {};
+  bool reportTypes[HID_MAX_REPORT_ID + 1][3] = {};
+  BLECharacteristic* sending = nullptr;
+  HidTransportListener* listener = nullptr;
+  TaskHandle_t loopTask = nullptr;
+  std::string deviceName;
+  std::string deviceManufacturer;
+  uint8_t batteryLevel;
+  bool connected = false;
+  AdvertisingPolicy policy = {ADV_FAST_INTERVAL_MS, ADV_FAST_TIME_S, ADV_SLOW_INTERVAL_MS, false};
+  AdvertisingPhase phase = ADV_OFF;
+  HidLinkParams linkRequest = {};
+  bool linkRequested = false;
+#if defined(USE_NIMBLE)
+  NimBLEAddress lastPeer;
+  bool hasPeer = false;
+  ble_gap_event_listener gapListener;
+
+  static NimbleTransport* active;
+  static void onAdvertisingComplete(NimBLEAdvertising* pAdvertising);
+  static int onGapEvent(ble_gap_event* event, void* arg);
+#endif
+
+  void setNotifications(bool enabled);
+  void startAdvertising(AdvertisingPhase next);
+
+public:
+  NimbleTransport(std::string deviceName, std::string deviceManufacturer, uint8_t batteryLevel);
+  void setName(std::string deviceName);
+  void setAdvertising(const AdvertisingPolicy& policy);
+  AdvertisingPhase advertisingPhase(void);
+
+  void addReport(HidReportType type, uint8_t id, const uint8_t* initial = nullptr, uint8_t length = 0) override;
+  void begin(const uint8_t* descriptor, uint16_t length, HidTransportListener* listener) override;
+  bool isConnected(void) override;
+  void send(uint8_t id, const uint8_t* data, uint8_t length) override;
+  void setBatteryLevel(uint8_t level) override;
+  void requestLinkParams(const HidLinkParams& params) override;
+
+protected:
+  virtual void onConnect(BLEServer* pServer) override;
+  virtual void onDisconnect(BLEServer* pServer) override;
+  virtual void onWrite(BLECharacteristic* me) override;
+#if defined(USE_NIMBLE)
+  virtual void onConnect(BLEServer* pServer, ble_gap_conn_desc* desc) override;
+  virtual void onStatus(NimBLECharacteristic* pCharacteristic, Status s, int code) override;
+  virtual void onAuthenticationComplete(ble_gap_conn_desc* desc) override;
+#endif
+};
+
+#endif // CONFIG_BT_ENABLED
+#endif // NIMBLE_TRANSPORT_H
@@ -0,0 +1,110 @@
+#include "RotaryEncoder.h"
+#include "GpioInput.h"
+#if SOC_PCNT_SUPPORTED
+#include <driver/pcnt.h>
+#endif
+
+// Count change for (previous AB << 2 | current AB), invalid double steps count 0
+static const int8_t QUADRATURE_TABLE[16] = {0, -1, 1, 0, 1, 0, 0, -1, -1, 0, 0, 1, 0, 1, -1, 0};
+
+bool RotaryEncoder::begin(uint8_t index, uint8_t a, uint8_t b, uint8_t steps)
+{
+  pinA = a;
+  pinB = b;
+  stepsPerDetent = steps > 0 ? steps : 1;
+  lastCount = 0;
+  remainder = 0;
+  pinMode(pinA, INPUT_PULLUP);
+  pinMode(pinB, INPUT_PULLUP);
+
+#if SOC_PCNT_SUPPORTED
+  if (index < SOC_PCNT_UNITS_PER_GROUP) {
+    // Channel 0 counts edges of A, direction from B; channel 1 the other way round
+    pcnt_config_t cfg = {};
+    cfg.unit = (pcnt_unit_t)index;
+    cfg.counter_h_lim = ENCODER_PCNT_LIMIT;
+    cfg.counter_l_lim = -ENCODER_PCNT_LIMIT;
+    cfg.channel = PCNT_CHANNEL_0;
+    cfg.pulse_gpio_num = pinA;
+    cfg.ctrl_gpio_num = pinB;
+    cfg.pos_mode = PCNT_COUNT_DEC;
+    cfg.neg_mode = PCNT_COUNT_INC;
+    cfg.lctrl_mode = PCNT_MODE_REVERSE;
+    cfg.hctrl_mode = PCNT_MODE_KEEP;
+    bool ok = pcnt_unit_config(&cfg) == ESP_OK;
+    cfg.channel = PCNT_CHANNEL_1;
+    cfg.pulse_gpio_num = pinB;
+    cfg.ctrl_gpio_num = pinA;
+    cfg.pos_mode = PCNT_COUNT_INC;
+    cfg.neg_mode = PCNT_COUNT_DEC;
+    ok = ok && pcnt_unit_config(&cfg) == ESP_OK;
+    if (ok) {
+      pcnt_set_filter_value(cfg.unit, ENCODER_FILTER_CYCLES);
+      pcnt_filter_enable(cfg.unit);
+      pcnt_counter_pause(cfg.unit);
+      pcnt_counter_clear(cfg.unit);
+      pcnt_counter_resume(cfg.unit);
+      unit = index;
+      hardware = true;
+      return true;
+    }
+  }
+#endif
+
+  // No (free) pulse counter: decode in the GPIO interrupt
+  hardware = false;
+  isrState = (GpioInput::readLevel(pinA) << 1) | GpioInput::readLevel(pinB);
+  isrCount.store(0, std::memory_order_relaxed);
+  attachInterruptArg(digitalPinToInterrupt(pinA), onEdge, this, CHANGE);
+  attachInterruptArg(digitalPinToInterrupt(pinB), onEdge, this, CHANGE);
+  return true;
+}
+
+void IRAM_ATTR RotaryEncoder::onEdge(void* arg)
+{
+  RotaryEncoder* enc = (RotaryEncoder*)arg;
+  uint8_t state = (GpioInput::readLevel(enc->pinA) << 1) | GpioInput::readLevel(enc->pinB);
+  int8_t step = QUADRATURE_TABLE[(enc->isrState << 2) | state];
+  enc->isrState = state;
+  if (step != 0) {
+    enc->isrCount.store(enc->isrCount.load(std::memory_order_relaxed) + step, std::memory_order_release);
+  }
+}
+
+bool RotaryEncoder::isHardware(void)
+{
+  return hardware;
+}
+
+int32_t RotaryEncoder::readCount(void)
+{
+#if SOC_PCNT_SUPPORTED
+  if (hardware) {
+    int16_t value = 0;
+    pcnt_get_counter_value((pcnt_unit_t)unit, &value);
+    return value;
+  }
+#endif
+  return isrCount.load(std::memory_order_acquire);
+}
+
+// Returns the whole detents turned since the last call (positive = clockwise),
+// partial detents are kept for the next call
+int32_t RotaryEncoder::readDetents(void)
+{
+  int32_t count = readCount();
+  int32_t delta = count - lastCount;
+  lastCount = count;
+  if (hardware) {
+    // The hardware counter restarts at 0 when it reaches +-ENCODER_PCNT_LIMIT
+    if (delta > ENCODER_PCNT_LIMIT / 2) {
+      delta -= ENCODER_PCNT_LIMIT;
+    } else if (delta < -ENCODER_PCNT_LIMIT / 2) {
+      delta += ENCODER_PCNT_LIMIT;
+    }
+  }
+  remainder += delta;
+  int32_t detents = remainder / stepsPerDetent;
+  remainder -= detents * stepsPerDetent;
+  return detents;
+}
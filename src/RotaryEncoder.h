@@ -0,0 +1,39 @@
+#ifndef ROTARY_ENCODER_H
+#define ROTARY_ENCODER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <soc/soc_caps.h>
+
+#define ENCODER_MAX 4
+#define ENCODER_PCNT_LIMIT 10000
+#define ENCODER_FILTER_CYCLES 1023 // glitch filter in APB cycles, 1023 = 12.8 us at 80 MHz
+
+// Quadrature rotary encoder. On chips with a pulse counter (PCNT) both edges of
+// both channels are counted in hardware; chips without one (ESP32-C3) decode the
+// quadrature state in a GPIO interrupt instead. Either way the loop only reads
+// the accumulated count, so no step is lost however fast the knob is turned.
+class RotaryEncoder
+{
+private:
+  uint8_t pinA = 0;
+  uint8_t pinB = 0;
+  uint8_t stepsPerDetent = 4;
+  bool hardware = false;
+  int unit = -1;
+  int32_t lastCount = 0;
+  int32_t remainder = 0;
+  // Written by the ISR only, read by the loop
+  std::atomic<int32_t> isrCount{0};
+  uint8_t isrState = 0;
+
+  static void onEdge(void* arg);
+  int32_t readCount(void);
+
+public:
+  bool begin(uint8_t index, uint8_t pinA, uint8_t pinB, uint8_t steps);
+  bool isHardware(void);
+  int32_t readDetents(void);
+};
+
+#endif // ROTARY_ENCODER_H
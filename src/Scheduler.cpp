@@ -0,0 +1,166 @@
+#include "Scheduler.h"
+
+#define SLOT_OF(t) ((t) & (SCHEDULER_WHEEL_SLOTS - 1))
+
+Scheduler::Scheduler()
+{
+  for (int s = 0; s < SCHEDULER_WHEEL_SLOTS; s++) {
+    slots[s] = SCHEDULER_NO_TIMER;
+  }
+}
+
+TimerId Scheduler::create(TimerCallback callback, void* arg)
+{
+  if (timerCount >= SCHEDULER_MAX_TIMERS) {
+    Serial.println("[DEBUG] Scheduler: no free timer, raise SCHEDULER_MAX_TIMERS");
+    return SCHEDULER_NO_TIMER;
+  }
+  TimerId id = timerCount++;
+  timers[id].callback = callback;
+  timers[id].arg = arg;
+  timers[id].expiry = 0;
+  timers[id].period = 0;
+  timers[id].next = SCHEDULER_NO_TIMER;
+  timers[id].slot = 0;
+  timers[id].armed = false;
+  timers[id].due = false;
+  return id;
+}
+
+void Scheduler::link(TimerId id)
+{
+  uint32_t slot = SLOT_OF(timers[id].expiry);
+  timers[id].slot = slot;
+  timers[id].next = slots[slot];
+  slots[slot] = id;
+  timers[id].armed = true;
+}
+
+void Scheduler::unlink(TimerId id)
+{
+  int8_t* p = &slots[timers[id].slot];
+  while (*p != SCHEDULER_NO_TIMER) {
+    if (*p == id) {
+      *p = timers[id].next;
+      break;
+    }
+    p = &timers[*p].next;
+  }
+  timers[id].next = SCHEDULER_NO_TIMER;
+  timers[id].armed = false;
+}
+
+void Scheduler::arm(TimerId id, uint32_t expiry, uint32_t period)
+{
+  if (id < 0 || id >= timerCount) {
+    return;
+  }
+  if (timers[id].armed) {
+    unlink(id);
+  }
+  if (!started) {
+    // Armed before the first run(): start the wheel now, otherwise a past
+    // expiry would sit in its raw slot until the wheel comes around
+    current = millis() - 1;
+    started = true;
+  }
+  if ((int32_t)(expiry - current) <= 0) {
+    expiry = current + 1;
+  }
+  timers[id].due = false;
+  timers[id].expiry = expiry;
+  timers[id].period = period;
+  link(id);
+}
+
+void Scheduler::armIn(TimerId id, uint32_t delayMs, uint32_t period)
+{
+  arm(id, millis() + delayMs, period);
+}
+
+void Scheduler::stop(TimerId id)
+{
+  if (id >= 0 && id < timerCount) {
+    if (timers[id].armed) {
+      unlink(id);
+    }
+    timers[id].due = false;
+  }
+}
+
+bool Scheduler::isArmed(TimerId id)
+{
+  return id >= 0 && id < timerCount && timers[id].armed;
+}
+
+// Fires every timer that expired up to now. Each millisecond maps to one slot,
+// a slot holds timers of later wheel rounds too, those are skipped by their expiry.
+// Due timers are collected first so callbacks may arm or stop timers freely.
+void Scheduler::run(uint32_t now)
+{
+  if (!started) {
+    current = now - 1;
+    started = true;
+  }
+  uint32_t elapsed = now - current;
+  if ((int32_t)elapsed <= 0) {
+    return;
+  }
+  if (elapsed > SCHEDULER_WHEEL_SLOTS) {
+    elapsed = SCHEDULER_WHEEL_SLOTS;
+  }
+  TimerId fired[SCHEDULER_MAX_TIMERS];
+  uint8_t firedCount = 0;
+  for (uint32_t n = 1; n <= elapsed; n++) {
+    uint32_t slot = SLOT_OF(current + n);
+    int8_t id = slots[slot];
+    while (id != SCHEDULER_NO_TIMER) {
+      int8_t next = timers[id].next;
+      if ((int32_t)(now - timers[id].expiry) >= 0) {
+        fired[firedCount++] = id;
+      }
+      id = next;
+    }
+  }
+  current = now;
+
+  for (uint8_t n = 0; n < firedCount; n++) {
+    TimerId id = fired[n];
+    unlink(id);
+    timers[id].due = true;
+    if (timers[id].period > 0) {
+      uint32_t expiry = timers[id].expiry + timers[id].period;
+      if ((int32_t)(now - expiry) >= 0) {
+        expiry = now + timers[id].period; // skipped periods are not made up
+      }
+      timers[id].expiry = expiry;
+      link(id);
+    }
+  }
+  for (uint8_t n = 0; n < firedCount; n++) {
+    TimerId id = fired[n];
+    if (timers[id].due) {
+      timers[id].due = false;
+      timers[id].callback(timers[id].arg);
+    }
+  }
+}
+
+// Milliseconds until the nearest armed timer, at most maxWait
+uint32_t Scheduler::msUntilNext(uint32_t now, uint32_t maxWait)
+{
+  uint32_t best = maxWait;
+  for (int id = 0; id < timerCount; id++) {
+    if (!timers[id].armed) {
+      continue;
+    }
+    int32_t diff = (int32_t)(timers[id].expiry - now);
+    if (diff <= 0) {
+      return 0;
+    }
+    if ((uint32_t)diff < best) {
+      best = diff;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,51 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+#define SCHEDULER_MAX_TIMERS 80
+#define SCHEDULER_WHEEL_SLOTS 64 // 1 ms per slot, power of two
+#define SCHEDULER_NO_TIMER -1
+
+typedef void (*TimerCallback)(void* arg);
+typedef int8_t TimerId;
+
+// Hashed timer wheel for one-shot and periodic deadlines, driven from loop()
+class Scheduler
+{
+  static_assert((SCHEDULER_WHEEL_SLOTS & (SCHEDULER_WHEEL_SLOTS - 1)) == 0, "wheel size must be a power of two");
+
+private:
+  typedef struct
+  {
+    TimerCallback callback;
+    void* arg;
+    uint32_t expiry;
+    uint32_t period;
+    int8_t next;  // next timer in the same slot
+    uint8_t slot;
+    bool armed;
+    bool due;     // collected by run(), cleared if re-armed or stopped before firing
+  } Timer;
+
+  Timer timers[SCHEDULER_MAX_TIMERS];
+  int8_t slots[SCHEDULER_WHEEL_SLOTS];
+  uint8_t timerCount = 0;
+  uint32_t current = 0; // last processed millisecond
+  bool started = false;
+
+  void link(TimerId id);
+  void unlink(TimerId id);
+
+public:
+  Scheduler();
+  TimerId create(TimerCallback callback, void* arg = nullptr);
+  void arm(TimerId id, uint32_t expiry, uint32_t period = 0);
+  void armIn(TimerId id, uint32_t delayMs, uint32_t period = 0);
+  void stop(TimerId id);
+  bool isArmed(TimerId id);
+  void run(uint32_t now);
+  uint32_t msUntilNext(uint32_t now, uint32_t maxWait);
+};
+
+#endif // SCHEDULER_H
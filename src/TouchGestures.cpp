@@ -0,0 +1,162 @@
+#include "TouchGestures.h"
+
+void TouchGestures::begin(BleComboAbs* combo, Scheduler* sched)
+{
+  hid = combo;
+  scheduler = sched;
+  timer = scheduler->create(onTimer, this);
+}
+
+void TouchGestures::setDebug(bool enabled)
+{
+  debugEnabled = enabled;
+}
+
+void TouchGestures::onTimer(void* arg)
+{
+  TouchGestures* touch = (TouchGestures*)arg;
+  touch->frame(millis());
+}
+
+void TouchGestures::clear(void)
+{
+  cancel();
+  count = 0;
+}
+
+int8_t TouchGestures::add(const String& gestureName, const TouchGesture& gesture)
+{
+  if (count >= TOUCH_MAX_GESTURES) {
+    return TOUCH_NONE;
+  }
+  gestures[count] = gesture;
+  if (gestures[count].frameMs == 0) {
+    gestures[count].frameMs = 1;
+  }
+  names[count] = gestureName;
+  return count++;
+}
+
+int8_t TouchGestures::find(const String& gestureName)
+{
+  for (uint8_t g = 0; g < count; g++) {
+    if (names[g] == gestureName) {
+      return g;
+    }
+  }
+  return TOUCH_NONE;
+}
+
+const String& TouchGestures::name(int8_t gesture)
+{
+  return names[gesture];
+}
+
+bool TouchGestures::isActive(void)
+{
+  return active != TOUCH_NONE;
+}
+
+bool TouchGestures::start(int8_t gesture, uint32_t now)
+{
+  if (hid == nullptr || gesture < 0 || gesture >= count) {
+    return false;
+  }
+  if (active != TOUCH_NONE) {
+    lift();
+  }
+  active = gesture;
+  started = now;
+  nextFrame = now;
+  frames = 0;
+  maxLate = 0;
+  frame(now);
+  return true;
+}
+
+void TouchGestures::cancel(void)
+{
+  if (active != TOUCH_NONE) {
+    lift();
+  }
+}
+
+void TouchGestures::lift(void)
+{
+  if (gestures[active].type == TOUCH_PINCH) {
+    hid->releaseTouch();
+  } else {
+    hid->releaseAbs();
+  }
+  if (debugEnabled) {
+    Serial.print("[DEBUG] Touch '");
+    Serial.print(names[active]);
+    Serial.print("' ended after ");
+    Serial.print(millis() - started);
+    Serial.print(" ms, ");
+    Serial.print(frames);
+    Serial.print(" frames, max frame delay ");
+    Serial.print(maxLate);
+    Serial.println(" ms");
+  }
+  active = TOUCH_NONE;
+  scheduler->stop(timer);
+}
+
+// Position at the current time, the last frame lands exactly on the end point
+void TouchGestures::frame(uint32_t now)
+{
+  if (active == TOUCH_NONE) {
+    return;
+  }
+  const TouchGesture& g = gestures[active];
+  uint32_t late = now - nextFrame;
+  if ((int32_t)late > 0 && late > maxLate) {
+    maxLate = late;
+  }
+  uint32_t elapsed = now - started;
+  bool last = elapsed >= g.duration;
+  if (last) {
+    elapsed = g.duration;
+  }
+  int32_t f = g.duration > 0 ? elapsed : 1;
+  int32_t d = g.duration > 0 ? g.duration : 1;
+  frames++;
+
+  switch (g.type) {
+    case TOUCH_SWIPE:
+      hid->moveAbs((int16_t)(g.x + (int32_t)(g.toX - g.x) * f / d),
+                   (int16_t)(g.y + (int32_t)(g.toY - g.y) * f / d));
+      break;
+    case TOUCH_HOLD:
+      if (frames == 1) {
+        hid->moveAbs(g.x, g.y);
+      }
+      break;
+    case TOUCH_PINCH: {
+      int32_t half = (g.spreadFrom + (int32_t)(g.spreadTo - g.spreadFrom) * f / d) / 2;
+      int32_t dx = g.vertical ? 0 : half;
+      int32_t dy = g.vertical ? half : 0;
+      hid->setTouch(0, true, (int16_t)constrain(g.x - dx, 0, 10000), (int16_t)constrain(g.y - dy, 0, 10000));
+      hid->setTouch(1, true, (int16_t)constrain(g.x + dx, 0, 10000), (int16_t)constrain(g.y + dy, 0, 10000));
+      break;
+    }
+  }
+
+  if (last) {
+    lift();
+    return;
+  }
+  if (g.type == TOUCH_HOLD) {
+    nextFrame = started + g.duration;
+  } else {
+    // Frames missed by a late tick are skipped, positions come from the time anyway
+    do {
+      nextFrame += g.frameMs;
+    } while ((int32_t)(nextFrame - now) <= 0);
+    if ((int32_t)(nextFrame - (started + g.duration)) > 0) {
+      nextFrame = started + g.duration;
+    }
+  }
+  scheduler->arm(timer, nextFrame);
+}
@@ -0,0 +1,69 @@
+#ifndef TOUCH_GESTURES_H
+#define TOUCH_GESTURES_H
+
+#include <Arduino.h>
+#include "BleComboAbs.h"
+#include "Scheduler.h"
+
+#define TOUCH_MAX_GESTURES 16
+#define TOUCH_NONE -1
+
+enum TouchGestureType : uint8_t
+{
+  TOUCH_SWIPE, // one finger from (x, y) to (toX, toY)
+  TOUCH_HOLD,  // one finger resting at (x, y)
+  TOUCH_PINCH  // two fingers around (x, y), distance spreadFrom -> spreadTo
+};
+
+// Coordinates 0..10000 like the absolute mouse
+typedef struct
+{
+  TouchGestureType type;
+  int16_t x;
+  int16_t y;
+  int16_t toX;
+  int16_t toY;
+  int16_t spreadFrom;
+  int16_t spreadTo;
+  bool vertical;     // pinch along the y axis
+  uint16_t duration; // ms
+  uint16_t frameMs;  // interval between two position updates
+} TouchGesture;
+
+// Plays touch gestures on the digitizer. Every frame is computed from the
+// elapsed time when it is due, nothing is precomputed. One gesture at a time,
+// a new one ends the running one.
+class TouchGestures
+{
+private:
+  BleComboAbs* hid = nullptr;
+  Scheduler* scheduler = nullptr;
+  TimerId timer = SCHEDULER_NO_TIMER;
+  TouchGesture gestures[TOUCH_MAX_GESTURES];
+  String names[TOUCH_MAX_GESTURES];
+  uint8_t count = 0;
+  int8_t active = TOUCH_NONE;
+  uint32_t started = 0;
+  uint32_t nextFrame = 0;
+  uint16_t frames = 0;
+  uint32_t maxLate = 0;
+  bool debugEnabled = false;
+
+  void frame(uint32_t now);
+  void lift(void);
+  static void onTimer(void* arg);
+
+public:
+  void begin(BleComboAbs* hid, Scheduler* scheduler);
+  void setDebug(bool enabled);
+  void clear(void);
+  int8_t add(const String& name, const TouchGesture& gesture);
+  int8_t find(const String& name);
+  const String& name(int8_t gesture);
+
+  bool start(int8_t gesture, uint32_t now);
+  void cancel(void);
+  bool isActive(void);
+};
+
+#endif // TOUCH_GESTURES_H
@@ -1,6 +1,4 @@
 // Timeout-Logik für Webserver
-unsigned long webserverStartTime = 0;
-unsigned long lastWebRequestTime = 0;
 bool webserverActive = false;
 const unsigned long WEBSERVER_TIMEOUT = 600000; // 10 Minuten
 
@@ -13,6 +11,21 @@ const unsigned long WEBSERVER_TIMEOUT = 600000; // 10 Minuten
 #include <DNSServer.h>
 #include <WiFiManager.h> // https://github.com/tzapu/WiFiManager
 #include "BleComboAbs.h"
+#include "GpioInput.h"
+#include "Debounce.h"
+#include "Gesture.h"
+#include "Scheduler.h"
+#include "MatrixInput.h"
+#include "ExpanderInput.h"
+#include "RotaryEncoder.h"
+#include "AnalogLadder.h"
+#include "ActionQueue.h"
+#include "KeyExpression.h"
+#include "ActionTable.h"
+#include "MacroEngine.h"
+#include "TouchGestures.h"
+#include "ActionReplay.h"
+#include <Wire.h>
 WebServer server(80);
 WiFiManager wm;
 bool debugOutput = false;
@@ -20,10 +33,29 @@ bool batteryEnabled = false;
 int batteryPin = -1;
 float batteryScale = 2.0f;
 uint32_t lastBatteryMv = 0;
-unsigned long batteryLastRead = 0;
 int lastBatteryPercent = -1;
 const unsigned long BATTERY_READ_INTERVAL = 60000;
+const uint32_t IDLE_WAIT_MS = 10;
+const uint32_t MAX_IDLE_WAIT_MS = 100;
+const uint32_t SCAN_INTERVAL_MS = 1;
+const uint32_t MATRIX_SCAN_INTERVAL_MS = 1;
+const uint32_t LADDER_SAMPLE_INTERVAL_MS = 1;
 BleComboAbs bleCombo;
+GpioInput gpioInput;
+Scheduler scheduler;
+TimerId webserverTimer = SCHEDULER_NO_TIMER;
+TimerId batteryTimer = SCHEDULER_NO_TIMER;
+ActionQueue actionQueue;
+MacroEngine macros;
+TouchGestures touchGestures;
+// Aktionen während eines Verbindungsabbruchs, werden nach dem Wiederverbinden nachgeholt
+ActionReplay actionReplay;
+TimerId replayTimer = SCHEDULER_NO_TIMER;
+ReplayPolicy defaultReplay = {REPLAY_DEFAULT_TTL_MS, false};
+uint16_t replayDelay = REPLAY_START_DELAY_MS;
+// Verbindungsprofil "race" oder "endurance", leer = der Host entscheidet
+String linkProfile = "";
+uint32_t lastLinkUpdates = 0;
 
 template <typename T>
 void debugPrint(const T& value) {
@@ -109,6 +141,22 @@ void updateBatteryLevel(bool force = false) {
   }
 }
 
+void onBatteryTimer(void* arg) {
+  updateBatteryLevel(false);
+}
+
+// Webserver-Anfrage: Timeout neu starten
+void noteWebRequest() {
+  scheduler.armIn(webserverTimer, WEBSERVER_TIMEOUT);
+}
+
+void onWebserverTimeout(void* arg) {
+  debugPrintln("[DEBUG] Webserver Timeout, stoppe Webserver und Access Point!");
+  server.stop();
+  WiFi.softAPdisconnect(true);
+  webserverActive = false;
+}
+
 // Hilfsfunktion: config.json als String laden
 String loadConfigString() {
   if (!LittleFS.begin(true)) return "{}";
@@ -162,6 +210,7 @@ const char* configEditorHTML = R"rawliteral(
   <label>Debug Ausgabe: <input id='debug_ble' name='debug_ble' type='checkbox'></label>
 
   <h3>Buttons</h3>
+  <p>Tasten: ein Zeichen (<code>I</code>), eine benannte Taste (<code>ENTER</code>, <code>F13</code>, <code>NUM_ENTER</code>, <code>PAGE_DOWN</code>), eine Kombination mit <code>+</code> (<code>CTRL+SHIFT+U</code>, <code>ALT+F4</code>) oder der Name einer Mausaktion, eines Makros oder einer Touch-Geste.</p>
   <div id='button-list' class='button-list'></div>
   <button type='button' class='add-btn' onclick='addButton()'>Button hinzufügen</button>
 
@@ -177,6 +226,11 @@ let config = {};
 let buttonList = document.getElementById('button-list');
 let mouseActionList = document.getElementById('mouse-action-list');
 
+// Wert für ein Attribut in einfachen Anführungszeichen, z.B. Tastenausdrücke mit ' oder &
+function attr(v) {
+  return String(v).replace(/&/g,'&amp;').replace(/'/g,'&#39;').replace(/</g,'&lt;');
+}
+
 function renderButtons() {
   buttonList.innerHTML = '';
   config.buttons.forEach((btn, idx) => {
@@ -186,15 +240,21 @@ function renderButtons() {
       <button type='button' class='remove-btn' onclick='removeButton(${idx})'>Entfernen</button>
       <b>Button ${idx+1}</b><br>
       Pin: <input type='number' value='${btn.pin}' onchange='updateButton(${idx},"pin",this.value)'>
-      Key normal: <input maxlength='1' value='${btn.key_normal||""}' onchange='updateButton(${idx},"key_normal",this.value)'>
-      Key double: <input maxlength='1' value='${btn.key_double||""}' onchange='updateButton(${idx},"key_double",this.value)'>
-      Key long: <input maxlength='1' value='${btn.key_long||""}' onchange='updateButton(${idx},"key_long",this.value)'>
+      Key normal: <input placeholder='CTRL+U' title='Zeichen, Tastenname, Kombination mit + oder Aktionsname' value='${attr(btn.key_normal||"")}' onchange='updateButton(${idx},"key_normal",this.value)'>
+      Key double: <input placeholder='CTRL+U' title='Zeichen, Tastenname, Kombination mit + oder Aktionsname' value='${attr(btn.key_double||"")}' onchange='updateButton(${idx},"key_double",this.value)'>
+      Key long: <input placeholder='CTRL+U' title='Zeichen, Tastenname, Kombination mit + oder Aktionsname' value='${attr(btn.key_long||"")}' onchange='updateButton(${idx},"key_long",this.value)'>
       Mode: <select onchange='updateButton(${idx},"mode",this.value)'>
         <option value='pullup' ${btn.mode=="pullup"?"selected":""}>pullup</option>
         <option value='pulldown' ${btn.mode=="pulldown"?"selected":""}>pulldown</option>
         <option value='input' ${btn.mode=="input"?"selected":""}>input</option>
       </select>
       Debounce: <input type='number' value='${btn.debounce||100}' onchange='updateButton(${idx},"debounce",this.value)'>
+      Entprellung: <select onchange='updateButton(${idx},"debounce_mode",this.value)'>
+        <option value='delay' ${(btn.debounce_mode||"delay")=="delay"?"selected":""}>delay</option>
+        <option value='eager' ${btn.debounce_mode=="eager"?"selected":""}>eager</option>
+        <option value='integrator' ${btn.debounce_mode=="integrator"?"selected":""}>integrator</option>
+        <option value='hardware' ${btn.debounce_mode=="hardware"?"selected":""}>hardware</option>
+      </select>
     `;
     buttonList.appendChild(div);
   });
@@ -221,7 +281,7 @@ function updateButton(idx, key, value) {
   config.buttons[idx][key] = value;
 }
 function addButton() {
-  config.buttons.push({pin:0,key_normal:"",key_double:"",key_long:"",mode:"pullup",debounce:100});
+  config.buttons.push({pin:0,key_normal:"",key_double:"",key_long:"",mode:"pullup",debounce:100,debounce_mode:"delay"});
   document.getElementById('ble_led_pin').value = config.ble_led_pin||'';
   document.getElementById('ble_led_invert').checked = !!config.ble_led_invert;
   renderButtons();
@@ -287,23 +347,113 @@ fetch('/config.json').then(r=>r.json()).then(j=>{
 )rawliteral";
 
 
-enum ButtonState { BTN_IDLE, BTN_DEBOUNCE, BTN_PRESSED, BTN_WAIT_DOUBLE, BTN_LONG, BTN_RELEASED };
+#define MAX_BUTTONS GESTURE_MAX_BUTTONS
+
+enum InputMode { INPUT_MODE_INTERRUPT, INPUT_MODE_SCAN };
+enum ButtonSource { BUTTON_SOURCE_GPIO, BUTTON_SOURCE_MATRIX, BUTTON_SOURCE_EXPANDER, BUTTON_SOURCE_LADDER };
 struct ButtonConfig {
   int pin;
+  ButtonSource source;
+  int key; // Tastenindex im Eingabe-Backend (Matrix/Expander/Ladder), -1 bei direktem GPIO
   String key_normal;
   String key_double;
   String key_long;
   String mode;
   int debounce;
-  int lastState;
-  unsigned long lastChange;
-  unsigned long pressStart;
-  unsigned long lastRelease;
-  ButtonState state;
-  bool doubleClickPending;
+  DebounceMode debounceMode;
+  unsigned long doubleClickTime;
+  unsigned long longPressTime;
+  unsigned long holdTime; // Dauer zwischen Drücken und Loslassen der gesendeten Taste
+  HoldPolicy holdPolicy;
+  uint8_t gamepadButton; // Gamepad-Knopf 1..32, 0 = Taste über die Gesten-Engine
+  uint8_t hatDirection;  // HAT_UP/RIGHT/DOWN/LEFT, 0 = kein Steuerkreuz
 };
-ButtonConfig buttons[12];
+// Laufzeitdaten als Struct-of-Arrays: der Scan berührt nur die Felder, die er braucht
+// (Pegel, Zeitstempel und Zustand je ein Array in Debounce, Gestenzustand in der Gesten-Engine)
+static_assert(MAX_BUTTONS <= DEBOUNCE_MAX_INPUTS, "Debounce muss alle Buttons fassen");
+struct ButtonRuntime {
+  Debounce debounce;
+};
+ButtonConfig buttons[MAX_BUTTONS];
+ButtonRuntime btn;
+TimerId buttonTimers[MAX_BUTTONS];
 int buttonCount = 0;
+InputMode inputMode = INPUT_MODE_INTERRUPT;
+DebounceMode defaultDebounceMode = DEBOUNCE_DELAY;
+HoldPolicy defaultHoldPolicy = HOLD_TIMEOUT;
+GestureEngine gestures;
+// Aktionsnamen der Gesten, die Gesten-Tabelle verweist per Index hierauf
+ActionTable actionTable; // beim Laden aufgelöste Aktionen, Gesten und Drehgeber speichern nur die ID
+int8_t pinToButton[GPIO_INPUT_MAX_PIN + 1];
+MatrixInput matrix;
+uint8_t matrixRows[MATRIX_MAX_ROWS];
+uint8_t matrixCols[MATRIX_MAX_COLS];
+uint8_t matrixRowCount = 0;
+uint8_t matrixColCount = 0;
+unsigned long matrixIdleTimeout = 200;
+unsigned long matrixLastActivity = 0;
+int8_t matrixToButton[MATRIX_MAX_KEYS];
+TimerId matrixTimer = SCHEDULER_NO_TIMER;
+ExpanderInput expander;
+ExpanderType expanderType = EXPANDER_NONE;
+uint8_t expanderAddress = 0x20;
+int expanderIntPin = -1;
+int expanderSda = -1;
+int expanderScl = -1;
+uint32_t expanderFreq = 400000;
+int8_t expanderToButton[EXPANDER_MAX_PINS];
+TimerId expanderTimer = SCHEDULER_NO_TIMER;
+AnalogLadder ladder;
+int ladderPin = -1;
+uint16_t ladderLevels[LADDER_MAX_KEYS];
+uint8_t ladderLevelCount = 0;
+uint16_t ladderIdleMv = 3300;
+uint8_t ladderConfirm = 3;
+int8_t ladderToButton[LADDER_MAX_KEYS];
+TimerId ladderTimer = SCHEDULER_NO_TIMER;
+
+// Hilfsfunktion: Laufzeitstatistik der Eingänge als JSON
+String inputStatsString() {
+  const ExpanderStats& st = expander.getStats();
+  String json = "{\"dropped_events\":" + String((unsigned long)gpioInput.droppedEvents());
+  json += ",\"expander\":{\"reads\":" + String((unsigned long)st.reads);
+  json += ",\"errors\":" + String((unsigned long)st.errors);
+  json += ",\"last_us\":" + String((unsigned long)st.lastUs);
+  json += ",\"max_us\":" + String((unsigned long)st.maxUs);
+  json += ",\"avg_us\":" + String((unsigned long)(st.reads ? st.totalUs / st.reads : 0));
+  const ReportStats& rs = bleCombo.getReportStats();
+  json += "},\"reports\":{\"sent\":" + String((unsigned long)rs.sent);
+  json += ",\"failed\":" + String((unsigned long)rs.failed);
+  json += ",\"retries\":" + String((unsigned long)rs.retries);
+  json += ",\"dropped\":" + String((unsigned long)rs.dropped);
+  json += ",\"last_us\":" + String((unsigned long)rs.lastUs);
+  json += ",\"max_us\":" + String((unsigned long)rs.maxUs);
+  json += ",\"avg_us\":" + String((unsigned long)(rs.sent ? rs.totalUs / rs.sent : 0));
+  json += ",\"conn_interval_us\":" + String((unsigned long)rs.connIntervalUs);
+  const LinkStats& ls = bleCombo.getLinkStats();
+  json += "},\"link\":{\"profile\":\"" + linkProfile + "\"";
+  json += ",\"interval_us\":" + String((unsigned long)ls.intervalUs);
+  json += ",\"latency\":" + String((unsigned long)ls.latency);
+  json += ",\"timeout_ms\":" + String((unsigned long)ls.timeoutMs);
+  json += ",\"updates\":" + String((unsigned long)ls.updates);
+  const ReconnectStats& cs = bleCombo.getReconnectStats();
+  json += "},\"reconnect\":{\"disconnects\":" + String((unsigned long)cs.disconnects);
+  json += ",\"last_connect_ms\":" + String((unsigned long)cs.lastConnectMs);
+  json += ",\"last_first_report_ms\":" + String((unsigned long)cs.lastFirstReportMs);
+  json += ",\"max_first_report_ms\":" + String((unsigned long)cs.maxFirstReportMs);
+  const ReplayStats& ps = actionReplay.getStats();
+  json += "},\"replay\":{\"buffered\":" + String((unsigned long)ps.buffered);
+  json += ",\"coalesced\":" + String((unsigned long)ps.coalesced);
+  json += ",\"replayed\":" + String((unsigned long)ps.replayed);
+  json += ",\"expired\":" + String((unsigned long)ps.expired);
+  json += ",\"dropped\":" + String((unsigned long)ps.dropped);
+  json += ",\"pending\":" + String((unsigned long)actionReplay.pending());
+  json += "}}";
+  return json;
+}
+
+unsigned long lastButtonTick = 0;
+uint32_t lastDroppedEvents = 0;
 String bleName = "ESP32 Keyboard";
 String wifiSSID = "";
 String wifiPASS = "";
@@ -312,17 +462,215 @@ struct MouseAction {
   String name;
   int x;
   int y;
+  uint16_t hold;
 };
 MouseAction mouseActions[8];
 int mouseActionCount = 0;
 
+// Drehgeber: Rastungen werden gesammelt und mit begrenzter Rate als Tasten-/Mausaktion gesendet
+#define MAX_ENCODERS ENCODER_MAX
+#define ENCODER_MAX_BACKLOG 8
+struct EncoderConfig {
+  int pinA;
+  int pinB;
+  String key_cw;
+  String key_ccw;
+  int16_t action_cw;
+  int16_t action_ccw;
+  uint8_t steps;
+  uint16_t interval;
+  uint16_t hold;
+};
+EncoderConfig encoders[MAX_ENCODERS];
+RotaryEncoder encoderInputs[MAX_ENCODERS];
+int32_t encoderPending[MAX_ENCODERS];
+TimerId encoderTimers[MAX_ENCODERS];
+int encoderCount = 0;
+
 // Globale Zeiten für Doppelklick und Langklick
 unsigned long doubleClickTime = 400; // ms
 unsigned long longPressTime = 800; // ms
+unsigned long keyHoldTime = 100; // ms
+bool nkroEnabled = false;
+// Gamepad-Modus: Buttons gehen als Bit in einen Gamepad-Report statt als Tastendruck
+bool gamepadEnabled = false;
+AdvertisingPolicy advertisingPolicy = {ADV_FAST_INTERVAL_MS, ADV_FAST_TIME_S, ADV_SLOW_INTERVAL_MS, false};
+#define HAT_UP 0x01
+#define HAT_RIGHT 0x02
+#define HAT_DOWN 0x04
+#define HAT_LEFT 0x08
+uint8_t hatPressed = 0;
 
 int bleLedPin = -1;
 bool bleLedInvert = false;
-void executeMouseAction(const String& actionName);
+void onGesture(uint8_t button, int16_t action, uint8_t taps, bool hold, bool repeat);
+void onButtonTimer(void* arg);
+void onMatrixScan(void* arg);
+void onExpanderPoll(void* arg);
+void onEncoderTimer(void* arg);
+void onLadderSample(void* arg);
+void onReplayTimer(void* arg);
+void wakeMatrix();
+
+// Steuerkreuz-Richtung aus der Konfiguration ("up", "right", "down", "left")
+uint8_t parseHat(const String& name) {
+  if (name == "up") return HAT_UP;
+  if (name == "right") return HAT_RIGHT;
+  if (name == "down") return HAT_DOWN;
+  if (name == "left") return HAT_LEFT;
+  return 0;
+}
+
+// Tastenausdruck ("a", "F5", "CTRL+SHIFT+U") einmalig in einen fertigen Report übersetzen
+void compileKey(const String& name, KeyReport& report) {
+  if (KeyExpression::compile(name, report)) {
+    return;
+  }
+  // Unbekannter Ausdruck: wie bisher nur das erste Zeichen senden
+  KeyExpression::compile(String(name[0]), report);
+  debugPrint("[DEBUG] Unbekannter Tastenausdruck '");
+  debugPrint(name);
+  debugPrintln("', sende erstes Zeichen");
+}
+
+// Aktion beim Laden auflösen: Mausaktion, Makro oder Touch-Geste per Name, sonst Tastenausdruck; gleiche Aktionen teilen sich einen Eintrag
+int16_t resolveAction(const String& name, uint16_t holdMs, const ReplayPolicy& replay) {
+  if (name.length() == 0) {
+    return ACTION_NONE;
+  }
+  int16_t id = ACTION_NONE;
+  bool found = false;
+  for (int m = 0; m < mouseActionCount; m++) {
+    if (mouseActions[m].name == name) {
+      id = actionTable.addAbsTap(name, mouseActions[m].x, mouseActions[m].y, mouseActions[m].hold, replay);
+      found = true;
+      break;
+    }
+  }
+  if (!found) {
+    int8_t macro = macros.find(name);
+    if (macro != MACRO_NONE) {
+      id = actionTable.addMacro(name, macro, replay);
+      found = true;
+    } else if (touchGestures.find(name) != TOUCH_NONE) {
+      id = actionTable.addTouch(name, touchGestures.find(name), replay);
+      found = true;
+    } else if (name == "MACRO_STOP") {
+      id = actionTable.addMacroStop(name, replay);
+      found = true;
+    }
+  }
+  if (!found) {
+    KeyReport report;
+    compileKey(name, report);
+    id = actionTable.addKey(name, report, holdMs, replay);
+  }
+  if (id == ACTION_NONE) {
+    debugPrintln("[DEBUG] Zu viele Aktionen, Eintrag ignoriert");
+  }
+  return id;
+}
+
+// Touch-Geste aus der Konfiguration: {"type": "swipe", "from": [x, y], "to": [x, y]}, {"type": "hold", "at": [x, y]}
+// oder {"type": "pinch", "at": [x, y], "from": Abstand, "to": Abstand}; dazu "duration" und "fps"
+void loadTouchGesture(JsonObject obj) {
+  TouchGesture g;
+  memset(&g, 0, sizeof(TouchGesture));
+  String type = obj["type"] | "swipe";
+  g.duration = obj["duration"] | 300;
+  int fps = obj["fps"] | 60;
+  g.frameMs = (uint16_t)(1000 / constrain(fps, 1, 1000));
+  if (type == "swipe") {
+    g.type = TOUCH_SWIPE;
+    g.x = (int16_t)constrain(obj["from"][0].as<int>(), 0, 10000);
+    g.y = (int16_t)constrain(obj["from"][1].as<int>(), 0, 10000);
+    g.toX = (int16_t)constrain(obj["to"][0].as<int>(), 0, 10000);
+    g.toY = (int16_t)constrain(obj["to"][1].as<int>(), 0, 10000);
+  } else if (type == "hold") {
+    g.type = TOUCH_HOLD;
+    g.x = (int16_t)constrain(obj["at"][0].as<int>(), 0, 10000);
+    g.y = (int16_t)constrain(obj["at"][1].as<int>(), 0, 10000);
+  } else if (type == "pinch") {
+    g.type = TOUCH_PINCH;
+    g.x = (int16_t)constrain(obj["at"][0].as<int>(), 0, 10000);
+    g.y = (int16_t)constrain(obj["at"][1].as<int>(), 0, 10000);
+    g.spreadFrom = (int16_t)constrain(obj["from"].as<int>(), 0, 10000);
+    g.spreadTo = (int16_t)constrain(obj["to"].as<int>(), 0, 10000);
+    g.vertical = obj["vertical"] | false;
+  } else {
+    debugPrint("[DEBUG] Unbekannter Touch-Gesten-Typ: ");
+    debugPrintln(type);
+    return;
+  }
+  if (touchGestures.add(obj["name"].as<String>(), g) == TOUCH_NONE) {
+    debugPrintln("[DEBUG] Zu viele Touch-Gesten, Eintrag ignoriert");
+  }
+}
+
+// Makro aus der Konfiguration übersetzen: Tasten als fertige Reports, Text als einzelne Anschläge
+void loadMacro(JsonObject obj) {
+  uint16_t gap = obj["gap"] | 20;
+  int8_t macro = macros.define(obj["name"].as<String>(), gap);
+  if (macro == MACRO_NONE) {
+    debugPrintln("[DEBUG] Zu viele Makros, Eintrag ignoriert");
+    return;
+  }
+  bool full = false;
+  for (JsonObject s : obj["steps"].as<JsonArray>()) {
+    MacroStep step;
+    memset(&step, 0, sizeof(MacroStep));
+    if (s.containsKey("text")) {
+      // Ein Anschlag pro Zeichen, Haltedauer mindestens 1 ms; den Abstand zum nächsten Anschlag hält MacroEngine
+      // auch bei "gap": 0 bei mindestens MACRO_MIN_TAP_GAP_MS, damit gleiche Buchstaben getrennt ankommen
+      String text = s["text"].as<String>();
+      step.type = MACRO_STEP_KEY_TAP;
+      step.ms = max((uint16_t)1, (uint16_t)(s["hold"] | gap));
+      for (unsigned int c = 0; c < text.length(); c++) {
+        memset(&step.report, 0, sizeof(KeyReport));
+        step.report.keys[0] = BleComboAbs::usageFromAscii((uint8_t)text[c], &step.report.modifiers);
+        if (step.report.keys[0] == 0) {
+          continue;
+        }
+        full |= !macros.addStep(step);
+      }
+      continue;
+    }
+    if (s.containsKey("down")) {
+      step.type = MACRO_STEP_KEY_DOWN;
+      compileKey(s["down"].as<String>(), step.report);
+    } else if (s.containsKey("up")) {
+      step.type = MACRO_STEP_KEY_UP;
+      compileKey(s["up"].as<String>(), step.report);
+    } else if (s.containsKey("key")) {
+      step.type = MACRO_STEP_KEY_TAP;
+      step.ms = s["hold"] | gap;
+      compileKey(s["key"].as<String>(), step.report);
+    } else if (s.containsKey("tap")) {
+      step.type = MACRO_STEP_ABS_TAP;
+      step.ms = s["hold"] | gap;
+      step.x = (int16_t)constrain(s["tap"][0].as<int>(), 0, 10000);
+      step.y = (int16_t)constrain(s["tap"][1].as<int>(), 0, 10000);
+    } else if (s.containsKey("move")) {
+      step.type = MACRO_STEP_ABS_MOVE;
+      step.x = (int16_t)constrain(s["move"][0].as<int>(), 0, 10000);
+      step.y = (int16_t)constrain(s["move"][1].as<int>(), 0, 10000);
+    } else if (s.containsKey("release")) {
+      step.type = MACRO_STEP_ABS_RELEASE;
+    } else if (s.containsKey("wait")) {
+      step.type = MACRO_STEP_WAIT;
+      step.ms = s["wait"].as<int>();
+    } else {
+      debugPrintln("[DEBUG] Unbekannter Makroschritt ignoriert");
+      continue;
+    }
+    full |= !macros.addStep(step);
+  }
+  if (full) {
+    debugPrint("[DEBUG] Zu viele Makroschritte, Makro gekürzt: ");
+    debugPrintln(obj["name"].as<String>());
+  }
+}
+
 void loadConfig() {
     debugPrint("[DEBUG] WLAN SSID: ");
     debugPrintln(wifiSSID);
@@ -337,7 +685,7 @@ void loadConfig() {
     debugPrintln("[DEBUG] /config.json konnte nicht geöffnet werden!");
     return;
   }
-  StaticJsonDocument<1024> doc;
+  DynamicJsonDocument doc(8192);
   DeserializationError err = deserializeJson(doc, file);
   if (err) {
     debugPrint("[DEBUG] Fehler beim Parsen von config.json: ");
@@ -353,6 +701,20 @@ void loadConfig() {
   if (doc.containsKey("longPressTime")) {
     longPressTime = doc["longPressTime"].as<unsigned long>();
   }
+  if (doc.containsKey("key_hold")) {
+    keyHoldTime = doc["key_hold"].as<unsigned long>();
+  }
+  if (doc.containsKey("nkro")) {
+    nkroEnabled = doc["nkro"].as<bool>();
+  }
+  gamepadEnabled = doc["gamepad"] | false;
+  // Advertising nach einem Verbindungsabbruch: erst schnell, dann langsam und stromsparend
+  advertisingPolicy.fastIntervalMs = doc["advertising"]["fast_interval"] | ADV_FAST_INTERVAL_MS;
+  advertisingPolicy.fastTimeS = doc["advertising"]["fast_time"] | ADV_FAST_TIME_S;
+  advertisingPolicy.slowIntervalMs = doc["advertising"]["slow_interval"] | ADV_SLOW_INTERVAL_MS;
+  advertisingPolicy.directed = doc["advertising"]["directed"] | false;
+  linkProfile = doc["link_profile"] | "";
+  hatPressed = 0;
   if (doc.containsKey("battery_enabled")) {
     batteryEnabled = doc["battery_enabled"].as<bool>();
   } else {
@@ -390,9 +752,150 @@ void loadConfig() {
   } else {
     debugOutput = false;
   }
+  if (doc.containsKey("input_mode") && doc["input_mode"].as<String>() == "scan") {
+    inputMode = INPUT_MODE_SCAN;
+  } else {
+    inputMode = INPUT_MODE_INTERRUPT;
+  }
   buttonCount = doc["buttons"].size();
+  if (buttonCount > MAX_BUTTONS) {
+    debugPrint("[DEBUG] Zu viele Buttons, maximal ");
+    debugPrintln(MAX_BUTTONS);
+    buttonCount = MAX_BUTTONS;
+  }
+  if (doc.containsKey("debounce_mode")) {
+    defaultDebounceMode = Debounce::parseMode(doc["debounce_mode"].as<String>());
+  }
+  if (doc.containsKey("hold_policy")) {
+    defaultHoldPolicy = GestureEngine::parsePolicy(doc["hold_policy"].as<String>());
+  }
+  actionTable.clear();
+  actionReplay.clear();
+
+  // Nachholen nach kurzem Verbindungsabbruch: "replay": {"ttl": ms, "coalesce": false, "delay": ms}, ttl 0 schaltet es ab.
+  // Zusammenfassen ist aus, sonst würden z.B. mehrere Gangwechsel zu einem
+  defaultReplay.ttl = doc["replay"]["ttl"] | REPLAY_DEFAULT_TTL_MS;
+  defaultReplay.coalesce = doc["replay"]["coalesce"] | false;
+  replayDelay = doc["replay"]["delay"] | REPLAY_START_DELAY_MS;
+
+  // Mausaktionen laden
+  mouseActionCount = 0;
+  if (doc.containsKey("mouse_actions")) {
+    JsonArray arr = doc["mouse_actions"].as<JsonArray>();
+    for (JsonObject obj : arr) {
+      if (mouseActionCount < 8) {
+        mouseActions[mouseActionCount].name = obj["name"].as<String>();
+        mouseActions[mouseActionCount].x = obj["x"].as<int>();
+        mouseActions[mouseActionCount].y = obj["y"].as<int>();
+        mouseActions[mouseActionCount].hold = obj["hold"] | 0;
+        mouseActionCount++;
+      }
+    }
+  }
+
+  // Touch-Gesten laden (vor den Buttons, damit Tasten sie per Name auslösen können)
+  touchGestures.clear();
+  if (doc.containsKey("touch_gestures")) {
+    JsonArray arr = doc["touch_gestures"].as<JsonArray>();
+    for (JsonObject obj : arr) {
+      loadTouchGesture(obj);
+    }
+  }
+
+  // Makros laden (vor den Buttons, damit Tasten sie per Name auslösen können)
+  macros.clear();
+  if (doc.containsKey("macros")) {
+    JsonArray arr = doc["macros"].as<JsonArray>();
+    for (JsonObject obj : arr) {
+      loadMacro(obj);
+    }
+  }
+
+  // Tastenmatrix: Zeilen werden reihum auf LOW gezogen, Spalten mit Pullup gelesen
+  matrixRowCount = 0;
+  matrixColCount = 0;
+  if (doc.containsKey("matrix")) {
+    JsonArray rows = doc["matrix"]["rows"].as<JsonArray>();
+    for (JsonVariant v : rows) {
+      int pin = v.as<int>();
+      if (matrixRowCount < MATRIX_MAX_ROWS && pin >= 0 && pin <= GPIO_INPUT_MAX_PIN) {
+        matrixRows[matrixRowCount++] = (uint8_t)pin;
+      }
+    }
+    JsonArray cols = doc["matrix"]["cols"].as<JsonArray>();
+    for (JsonVariant v : cols) {
+      int pin = v.as<int>();
+      if (matrixColCount < MATRIX_MAX_COLS && pin >= 0 && pin <= GPIO_INPUT_MAX_PIN) {
+        matrixCols[matrixColCount++] = (uint8_t)pin;
+      }
+    }
+    if (doc["matrix"].containsKey("idle_timeout")) {
+      matrixIdleTimeout = doc["matrix"]["idle_timeout"].as<unsigned long>();
+    }
+  }
+
+  // IO-Expander am I2C-Bus, gelesen bei fallender Flanke der INT-Leitung
+  expanderType = EXPANDER_NONE;
+  if (doc.containsKey("expander")) {
+    expanderType = ExpanderInput::parseType(doc["expander"]["type"].as<String>());
+    expanderAddress = doc["expander"]["address"] | 0x20;
+    expanderIntPin = doc["expander"]["int_pin"] | -1;
+    expanderSda = doc["expander"]["sda"] | -1;
+    expanderScl = doc["expander"]["scl"] | -1;
+    expanderFreq = doc["expander"]["freq"] | 400000;
+  }
+
+  // Widerstandsleiter: mehrere Tasten an einem ADC-Pin, Spannung pro Taste in mV
+  ladderPin = -1;
+  ladderLevelCount = 0;
+  if (doc.containsKey("ladder")) {
+    ladderPin = doc["ladder"]["pin"] | -1;
+    JsonArray levels = doc["ladder"]["levels"].as<JsonArray>();
+    for (JsonVariant v : levels) {
+      if (ladderLevelCount < LADDER_MAX_KEYS) {
+        ladderLevels[ladderLevelCount++] = v.as<uint16_t>();
+      }
+    }
+    ladderIdleMv = doc["ladder"]["idle"] | 3300;
+    ladderConfirm = doc["ladder"]["samples"] | 3;
+  }
+
   for (int i = 0; i < buttonCount; i++) {
-    buttons[i].pin = doc["buttons"][i]["pin"].as<int>();
+    buttons[i].pin = doc["buttons"][i]["pin"] | -1;
+    buttons[i].source = BUTTON_SOURCE_GPIO;
+    buttons[i].key = -1;
+    if (doc["buttons"][i].containsKey("matrix")) {
+      int row = doc["buttons"][i]["matrix"][0] | -1;
+      int col = doc["buttons"][i]["matrix"][1] | -1;
+      if (row >= 0 && row < matrixRowCount && col >= 0 && col < matrixColCount) {
+        buttons[i].source = BUTTON_SOURCE_MATRIX;
+        buttons[i].key = row * matrixColCount + col;
+        buttons[i].pin = -1;
+      } else {
+        debugPrint("[DEBUG] Ungültige Matrix-Position bei Button ");
+        debugPrintln(i);
+      }
+    } else if (doc["buttons"][i].containsKey("expander")) {
+      int pin = doc["buttons"][i]["expander"] | -1;
+      if (expanderType != EXPANDER_NONE && pin >= 0 && pin < EXPANDER_MAX_PINS) {
+        buttons[i].source = BUTTON_SOURCE_EXPANDER;
+        buttons[i].key = pin;
+        buttons[i].pin = -1;
+      } else {
+        debugPrint("[DEBUG] Ungültiger Expander-Pin bei Button ");
+        debugPrintln(i);
+      }
+    } else if (doc["buttons"][i].containsKey("ladder")) {
+      int key = doc["buttons"][i]["ladder"] | -1;
+      if (ladderPin >= 0 && key >= 0 && key < ladderLevelCount) {
+        buttons[i].source = BUTTON_SOURCE_LADDER;
+        buttons[i].key = key;
+        buttons[i].pin = -1;
+      } else {
+        debugPrint("[DEBUG] Ungültige Ladder-Stufe bei Button ");
+        debugPrintln(i);
+      }
+    }
     if (doc["buttons"][i].containsKey("key_normal"))
       buttons[i].key_normal = doc["buttons"][i]["key_normal"].as<String>();
     else if (doc["buttons"][i].containsKey("key"))
@@ -407,6 +910,18 @@ void loadConfig() {
       buttons[i].key_long = doc["buttons"][i]["key_long"].as<String>();
     else
       buttons[i].key_long = buttons[i].key_normal;
+    if (doc["buttons"][i].containsKey("doubleClickTime"))
+      buttons[i].doubleClickTime = doc["buttons"][i]["doubleClickTime"].as<unsigned long>();
+    else
+      buttons[i].doubleClickTime = doubleClickTime;
+    if (doc["buttons"][i].containsKey("longPressTime"))
+      buttons[i].longPressTime = doc["buttons"][i]["longPressTime"].as<unsigned long>();
+    else
+      buttons[i].longPressTime = longPressTime;
+    if (doc["buttons"][i].containsKey("hold"))
+      buttons[i].holdTime = doc["buttons"][i]["hold"].as<unsigned long>();
+    else
+      buttons[i].holdTime = keyHoldTime;
     if (doc["buttons"][i].containsKey("mode")) {
       buttons[i].mode = doc["buttons"][i]["mode"].as<String>();
     } else {
@@ -417,24 +932,87 @@ void loadConfig() {
     } else {
       buttons[i].debounce = 100;
     }
-    buttons[i].lastState = HIGH;
-    buttons[i].lastChange = 0;
-    buttons[i].pressStart = 0;
-    buttons[i].lastRelease = 0;
-    buttons[i].state = BTN_IDLE;
-    buttons[i].doubleClickPending = false;
+    if (doc["buttons"][i].containsKey("debounce_mode")) {
+      buttons[i].debounceMode = Debounce::parseMode(doc["buttons"][i]["debounce_mode"].as<String>());
+    } else {
+      buttons[i].debounceMode = defaultDebounceMode;
+    }
+    if (doc["buttons"][i].containsKey("hold_policy")) {
+      buttons[i].holdPolicy = GestureEngine::parsePolicy(doc["buttons"][i]["hold_policy"].as<String>());
+    } else {
+      buttons[i].holdPolicy = defaultHoldPolicy;
+    }
+    // Gamepad: im Gamepad-Modus wird Button i zu Knopf i+1, "gamepad": n oder "hat" legt es fest
+    buttons[i].hatDirection = parseHat(doc["buttons"][i]["hat"] | "");
+    int pad = doc["buttons"][i]["gamepad"] | ((gamepadEnabled && buttons[i].hatDirection == 0) ? i + 1 : 0);
+    buttons[i].gamepadButton = (pad >= 1 && pad <= GAMEPAD_BUTTON_COUNT && buttons[i].hatDirection == 0) ? pad : 0;
+    btn.debounce.init(i, buttons[i].debounceMode, (uint16_t)buttons[i].debounce, HIGH);
+
+    // Tastenwiederholung beim Halten: "repeat": true, Verzögerung in ms, Rate in Anschlägen pro Sekunde.
+    // Die Haltedauer muss kürzer als der Abstand sein, sonst verschmelzen die Anschläge.
+    uint16_t repeatDelay = 0;
+    uint16_t repeatInterval = 0;
+    if (doc["buttons"][i]["repeat"] | false) {
+      repeatDelay = doc["buttons"][i]["repeat_delay"] | 300;
+      int rate = doc["buttons"][i]["repeat_rate"] | 20;
+      repeatInterval = (uint16_t)(1000 / constrain(rate, 1, 100));
+      if (buttons[i].holdTime >= repeatInterval) {
+        buttons[i].holdTime = repeatInterval / 2;
+      }
+    }
+
+    ReplayPolicy replay;
+    replay.ttl = doc["buttons"][i]["replay_ttl"] | defaultReplay.ttl;
+    replay.coalesce = doc["buttons"][i]["replay_coalesce"] | defaultReplay.coalesce;
+
+    // Gesten-Tabelle aufbauen. Nur echte Gesten kosten Wartezeit:
+    // gleiche oder leere Belegung zählt nicht als eigene Aktion
+    gestures.clear(i);
+    gestures.bindTap(i, 1, resolveAction(buttons[i].key_normal, (uint16_t)buttons[i].holdTime, replay));
+    if (buttons[i].key_double != buttons[i].key_normal) {
+      gestures.bindTap(i, 2, resolveAction(buttons[i].key_double, (uint16_t)buttons[i].holdTime, replay));
+    }
+    if (buttons[i].key_long != buttons[i].key_normal) {
+      gestures.bindHold(i, 0, resolveAction(buttons[i].key_long, (uint16_t)buttons[i].holdTime, replay));
+    }
+    // Weitere Gesten: {"taps": 3, "key": "X"} oder {"taps": 1, "hold": true, "key": "Y"} (Tap-Hold)
+    if (doc["buttons"][i].containsKey("gestures")) {
+      JsonArray list = doc["buttons"][i]["gestures"].as<JsonArray>();
+      for (JsonObject g : list) {
+        bool hold = g["hold"] | false;
+        int taps = g["taps"] | (hold ? 0 : 1);
+        int16_t action = resolveAction(g["key"].as<String>(), (uint16_t)buttons[i].holdTime, replay);
+        if (hold) {
+          gestures.bindHold(i, (uint8_t)taps, action);
+        } else {
+          gestures.bindTap(i, (uint8_t)taps, action);
+        }
+      }
+    }
+    gestures.compile(i, (uint16_t)buttons[i].doubleClickTime, (uint16_t)buttons[i].longPressTime, buttons[i].holdPolicy);
+    gestures.setRepeat(i, repeatDelay, repeatInterval);
   }
 
-  // Mausaktionen laden
-  mouseActionCount = 0;
-  if (doc.containsKey("mouse_actions")) {
-    JsonArray arr = doc["mouse_actions"].as<JsonArray>();
+  // Drehgeber laden
+  encoderCount = 0;
+  if (doc.containsKey("encoders")) {
+    JsonArray arr = doc["encoders"].as<JsonArray>();
     for (JsonObject obj : arr) {
-      if (mouseActionCount < 8) {
-        mouseActions[mouseActionCount].name = obj["name"].as<String>();
-        mouseActions[mouseActionCount].x = obj["x"].as<int>();
-        mouseActions[mouseActionCount].y = obj["y"].as<int>();
-        mouseActionCount++;
+      if (encoderCount < MAX_ENCODERS) {
+        encoders[encoderCount].pinA = obj["pin_a"] | -1;
+        encoders[encoderCount].pinB = obj["pin_b"] | -1;
+        encoders[encoderCount].key_cw = obj["key_cw"].as<String>();
+        encoders[encoderCount].key_ccw = obj["key_ccw"].as<String>();
+        encoders[encoderCount].hold = obj["hold"] | 10;
+        // Jede Rastung zählt, daher standardmäßig nicht zusammenfassen
+        ReplayPolicy replay;
+        replay.ttl = obj["replay_ttl"] | defaultReplay.ttl;
+        replay.coalesce = obj["replay_coalesce"] | false;
+        encoders[encoderCount].action_cw = resolveAction(encoders[encoderCount].key_cw, encoders[encoderCount].hold, replay);
+        encoders[encoderCount].action_ccw = resolveAction(encoders[encoderCount].key_ccw, encoders[encoderCount].hold, replay);
+        encoders[encoderCount].steps = obj["steps"] | 4;
+        encoders[encoderCount].interval = obj["interval"] | 30;
+        encoderCount++;
       }
     }
   }
@@ -457,36 +1035,12 @@ void loadConfig() {
     debugPrint("', Key_long '");
     debugPrint(buttons[i].key_long);
     debugPrint("', Mode: ");
-    debugPrintln(buttons[i].mode);
+    debugPrint(buttons[i].mode);
+    debugPrintln(gestures.firesOnPress(i) ? " (sofort beim Drücken)" : "");
   }
 }
 
 // Hilfsfunktion: Mausaktion ausführen
-void executeMouseAction(const String& actionName) {
-  for (int i = 0; i < mouseActionCount; i++) {
-    if (mouseActions[i].name == actionName) {
-      int mx = mouseActions[i].x;
-      int my = mouseActions[i].y;
-      if (!bleCombo.isConnected()) {
-        debugPrintln("[DEBUG] BLE nicht verbunden, Aktion ignoriert");
-        return;
-      }
-      if (mx < 0) mx = 0;
-      if (my < 0) my = 0;
-      if (mx > 10000) mx = 10000;
-      if (my > 10000) my = 10000;
-      debugPrint("[DEBUG] Abs Mouse action: ");
-      debugPrint(actionName);
-      debugPrint(" x=");
-      debugPrint(mx);
-      debugPrint(" y=");
-      debugPrintln(my);
-      bleCombo.clickAbs(mx, my);
-      return;
-    }
-  }
-}
-
 void setup() {
     Serial.begin(115200);
     delay(5000); // Warte auf Serial-Port Initialisierung
@@ -494,6 +1048,7 @@ void setup() {
     debugPrintln("[DEBUG] Serial initialisiert");
     // Captive Portal starten, falls kein WLAN konfiguriert
     loadConfig();
+    webserverTimer = scheduler.create(onWebserverTimeout);
     bool wifiConnected = false;
     if (wifiSSID.length() > 0) {
       WiFi.mode(WIFI_STA);
@@ -524,17 +1079,22 @@ void setup() {
       Serial.println(WiFi.softAPIP());
       // Webserver Endpunkte
       server.on("/", []() {
-        lastWebRequestTime = millis();
+        noteWebRequest();
         debugPrintln("[DEBUG] HTTP GET /");
         server.send(200, "text/html", configEditorHTML);
       });
       server.on("/config.json", []() {
-        lastWebRequestTime = millis();
+        noteWebRequest();
         debugPrintln("[DEBUG] HTTP GET /config.json");
         server.send(200, "application/json", loadConfigString());
       });
+      server.on("/stats", []() {
+        noteWebRequest();
+        debugPrintln("[DEBUG] HTTP GET /stats");
+        server.send(200, "application/json", inputStatsString());
+      });
       server.on("/save", HTTP_POST, []() {
-        lastWebRequestTime = millis();
+        noteWebRequest();
         debugPrintln("[DEBUG] HTTP POST /save");
         String body = server.arg("plain");
         if (saveConfigString(body)) {
@@ -546,26 +1106,30 @@ void setup() {
         }
       });
       server.begin();
-      webserverStartTime = millis();
-      lastWebRequestTime = millis();
       webserverActive = true;
+      noteWebRequest();
       Serial.println("Webserver gestartet (Port 80)");
     } else {
       Serial.print("WLAN verbunden: ");
       Serial.println(WiFi.localIP());
       // Webserver für lokale Bearbeitung (optional)
       server.on("/", []() {
-        lastWebRequestTime = millis();
+        noteWebRequest();
         debugPrintln("[DEBUG] HTTP GET /");
         server.send(200, "text/html", configEditorHTML);
       });
       server.on("/config.json", []() {
-        lastWebRequestTime = millis();
+        noteWebRequest();
         debugPrintln("[DEBUG] HTTP GET /config.json");
         server.send(200, "application/json", loadConfigString());
       });
+      server.on("/stats", []() {
+        noteWebRequest();
+        debugPrintln("[DEBUG] HTTP GET /stats");
+        server.send(200, "application/json", inputStatsString());
+      });
       server.on("/save", HTTP_POST, []() {
-        lastWebRequestTime = millis();
+        noteWebRequest();
         debugPrintln("[DEBUG] HTTP POST /save");
         String body = server.arg("plain");
         if (saveConfigString(body)) {
@@ -577,9 +1141,8 @@ void setup() {
         }
       });
       server.begin();
-      webserverStartTime = millis();
-      lastWebRequestTime = millis();
       webserverActive = true;
+      noteWebRequest();
       debugPrintln("[DEBUG] Webserver gestartet (Port 80)");
     }
   //pinMode(8, OUTPUT);
@@ -589,6 +1152,44 @@ void setup() {
   debugPrintln("[DEBUG] Serial initialisiert");
   loadConfig();
   debugPrintln("[DEBUG] Konfiguration geladen");
+  gpioInput.begin();
+  actionQueue.begin(&bleCombo, &scheduler);
+  macros.begin(&bleCombo, &scheduler);
+  touchGestures.begin(&bleCombo, &scheduler);
+  replayTimer = scheduler.create(onReplayTimer);
+  gestures.setCallback(onGesture);
+  for (int i = 0; i < buttonCount; i++) {
+    buttonTimers[i] = scheduler.create(onButtonTimer, (void*)(intptr_t)i);
+  }
+  uint64_t scanMask = 0;
+  for (int p = 0; p <= GPIO_INPUT_MAX_PIN; p++) {
+    pinToButton[p] = -1;
+  }
+  for (int k = 0; k < MATRIX_MAX_KEYS; k++) {
+    matrixToButton[k] = -1;
+  }
+  for (int k = 0; k < EXPANDER_MAX_PINS; k++) {
+    expanderToButton[k] = -1;
+  }
+  for (int k = 0; k < LADDER_MAX_KEYS; k++) {
+    ladderToButton[k] = -1;
+  }
+  if (expanderType != EXPANDER_NONE) {
+    Wire.begin(expanderSda, expanderScl, expanderFreq);
+    if (expander.begin(&gpioInput, Wire, expanderType, expanderAddress, expanderIntPin)) {
+      debugPrint("[DEBUG] IO-Expander initialisiert: ");
+      debugPrint(ExpanderInput::typeName(expanderType));
+      debugPrint(" an 0x");
+      debugPrintln(String(expanderAddress, HEX));
+      if (expanderIntPin < 0) {
+        // Ohne INT-Leitung bleibt nur zyklisches Lesen
+        expanderTimer = scheduler.create(onExpanderPoll);
+        scheduler.armIn(expanderTimer, SCAN_INTERVAL_MS, SCAN_INTERVAL_MS);
+      }
+    } else {
+      debugPrintln("[DEBUG] IO-Expander antwortet nicht!");
+    }
+  }
   for (int i = 0; i < buttonCount; i++) {
     debugPrint("Init Button ");
     debugPrint(i);
@@ -603,7 +1204,37 @@ void setup() {
     debugPrint("', Mode: ");
     debugPrint(buttons[i].mode);
     debugPrint(", Debounce: ");
-    debugPrintln(buttons[i].debounce);
+    debugPrint(buttons[i].debounce);
+    debugPrint(" (");
+    debugPrint(Debounce::modeName(buttons[i].debounceMode));
+    debugPrintln(")");
+    if (buttons[i].source == BUTTON_SOURCE_MATRIX) {
+      debugPrint("[DEBUG] Matrix-Taste ");
+      debugPrintln(buttons[i].key);
+      btn.debounce.init(i, buttons[i].debounceMode, (uint16_t)buttons[i].debounce, HIGH);
+      matrixToButton[buttons[i].key] = i;
+      continue;
+    }
+    if (buttons[i].source == BUTTON_SOURCE_LADDER) {
+      debugPrint("[DEBUG] Ladder-Stufe ");
+      debugPrint(buttons[i].key);
+      debugPrint(" bei ");
+      debugPrint(ladderLevels[buttons[i].key]);
+      debugPrintln(" mV");
+      btn.debounce.init(i, buttons[i].debounceMode, (uint16_t)buttons[i].debounce, HIGH);
+      ladderToButton[buttons[i].key] = i;
+      continue;
+    }
+    if (buttons[i].source == BUTTON_SOURCE_EXPANDER) {
+      debugPrint("[DEBUG] Expander-Pin ");
+      debugPrintln(buttons[i].key);
+      if (buttons[i].key < expander.pinCount()) {
+        uint8_t level = (expander.level() >> buttons[i].key) & 0x1;
+        btn.debounce.init(i, buttons[i].debounceMode, (uint16_t)buttons[i].debounce, level);
+        expanderToButton[buttons[i].key] = i;
+      }
+      continue;
+    }
     if (buttons[i].pin < 0 || buttons[i].pin > 39) {
       debugPrint("Warnung: Ungültiger GPIO: ");
       debugPrintln(buttons[i].pin);
@@ -619,7 +1250,43 @@ void setup() {
       pinMode(buttons[i].pin, INPUT);
       debugPrintln("[DEBUG] pinMode INPUT gesetzt");
     }
+    // Flanken per Interrupt erfassen oder im Scan-Modus über das Eingangsregister
+    btn.debounce.init(i, buttons[i].debounceMode, (uint16_t)buttons[i].debounce, (uint8_t)GpioInput::readLevel(buttons[i].pin));
+    if (buttons[i].debounceMode == DEBOUNCE_HARDWARE && !Debounce::enableHardwareFilter(buttons[i].pin)) {
+      debugPrintln("[DEBUG] Kein Hardware-Glitchfilter verfügbar, nur Software-Sperrzeit aktiv");
+    }
+    pinToButton[buttons[i].pin] = i;
+    if (inputMode == INPUT_MODE_SCAN) {
+      scanMask |= (uint64_t)1 << buttons[i].pin;
+    } else {
+      gpioInput.attach(buttons[i].pin);
+    }
   }
+  gpioInput.setScanMask(scanMask);
+  if (ladderPin >= 0 && ladderLevelCount > 0) {
+    if (ladder.begin(ladderPin, ladderLevels, ladderLevelCount, ladderIdleMv, ladderConfirm)) {
+      ladderTimer = scheduler.create(onLadderSample);
+      scheduler.armIn(ladderTimer, LADDER_SAMPLE_INTERVAL_MS, LADDER_SAMPLE_INTERVAL_MS);
+      debugPrint("[DEBUG] Widerstandsleiter an Pin ");
+      debugPrintln(ladderPin);
+    } else {
+      debugPrintln("[DEBUG] Widerstandsleiter ignoriert: eine Taste liegt auf der Ruhespannung");
+    }
+  }
+  if (matrixRowCount > 0 && matrixColCount > 0) {
+    if (matrix.begin(&gpioInput, matrixRows, matrixRowCount, matrixCols, matrixColCount)) {
+      matrixTimer = scheduler.create(onMatrixScan);
+      wakeMatrix();
+      debugPrint("[DEBUG] Tastenmatrix initialisiert: ");
+      debugPrint(matrixRowCount);
+      debugPrint("x");
+      debugPrintln(matrixColCount);
+    } else {
+      debugPrintln("[DEBUG] Tastenmatrix ungültig konfiguriert!");
+    }
+  }
+  debugPrint("[DEBUG] Input-Modus: ");
+  debugPrintln(inputMode == INPUT_MODE_SCAN ? "scan" : "interrupt");
   debugPrintln("[DEBUG] Alle Pins initialisiert");
   if (bleLedPin >= 0 && bleLedPin <= 39) {
     pinMode(bleLedPin, OUTPUT);
@@ -636,9 +1303,40 @@ void setup() {
     adcAttachPin(batteryPin);
     debugPrint("[DEBUG] Battery Pin initialisiert: ");
     debugPrintln(batteryPin);
+    batteryTimer = scheduler.create(onBatteryTimer);
+    scheduler.armIn(batteryTimer, BATTERY_READ_INTERVAL, BATTERY_READ_INTERVAL);
+  }
+  for (int e = 0; e < encoderCount; e++) {
+    if (encoders[e].pinA < 0 || encoders[e].pinA > GPIO_INPUT_MAX_PIN || encoders[e].pinB < 0 || encoders[e].pinB > GPIO_INPUT_MAX_PIN) {
+      debugPrint("[DEBUG] Ungültige Pins bei Drehgeber ");
+      debugPrintln(e);
+      continue;
+    }
+    encoderInputs[e].begin(e, encoders[e].pinA, encoders[e].pinB, encoders[e].steps);
+    encoderPending[e] = 0;
+    encoderTimers[e] = scheduler.create(onEncoderTimer, (void*)(intptr_t)e);
+    scheduler.armIn(encoderTimers[e], encoders[e].interval, encoders[e].interval);
+    debugPrint("[DEBUG] Drehgeber ");
+    debugPrint(e);
+    debugPrintln(encoderInputs[e].isHardware() ? " über Pulszähler (PCNT)" : " über GPIO-Interrupt");
   }
   bleCombo.setName(bleName.c_str());
   bleCombo.setDebug(debugOutput);
+  macros.setDebug(debugOutput);
+  touchGestures.setDebug(debugOutput);
+  bleCombo.setNkro(nkroEnabled);
+  bleCombo.setAdvertising(advertisingPolicy);
+  HidLinkParams linkParams;
+  if (BleComboAbs::parseLinkProfile(linkProfile.c_str(), linkParams)) {
+    bleCombo.setLinkProfile(linkParams);
+    debugPrint("[DEBUG] Verbindungsprofil: ");
+    debugPrintln(linkProfile);
+  } else if (linkProfile.length() > 0) {
+    debugPrint("[DEBUG] Unbekanntes Verbindungsprofil '");
+    debugPrint(linkProfile);
+    debugPrintln("', der Host entscheidet");
+    linkProfile = "";
+  }
   debugPrintln("[DEBUG] BLE-Name gesetzt");
   bleCombo.begin();
   updateBatteryLevel(true);
@@ -648,174 +1346,401 @@ void setup() {
   Serial.println(")");
 }
 
-unsigned long bleLedLastToggle = 0;
-bool bleLedState = false;
-bool bleWasConnected = false;
-unsigned long bleDisconnectTime = 0;
-bool bleFastBlinkActive = false;
-void loop() {
-    if (webserverActive) {
-      server.handleClient();
-      // Timeout prüfen
-      if ((millis() - lastWebRequestTime > WEBSERVER_TIMEOUT) && (millis() - webserverStartTime > WEBSERVER_TIMEOUT)) {
-        debugPrintln("[DEBUG] Webserver Timeout, stoppe Webserver und Access Point!");
-        server.stop();
-        WiFi.softAPdisconnect(true);
-        webserverActive = false;
-      }
+// Aufgelöste Aktion über die Action-Queue senden: nur ein Tabellenzugriff, keine Namensvergleiche.
+// Drücken geht sofort raus, Loslassen nach der Haltedauer, loop() wartet nicht.
+void runAction(int16_t action) {
+  if (action == ACTION_NONE) {
+    Serial.println();
+    return;
+  }
+  Serial.print(": ");
+  Serial.println(actionTable.name(action));
+  // Ohne Verbindung (und solange noch nachgeholt wird, damit die Reihenfolge stimmt) puffern
+  if (!bleCombo.isConnected() || actionReplay.pending() > 0) {
+    if (actionReplay.push(action, actionTable.get(action).replay, millis())) {
+      debugPrintln("[DEBUG] BLE nicht verbunden, Aktion wird nachgeholt");
+      return;
+    }
+    if (!bleCombo.isConnected()) {
+      debugPrintln("[DEBUG] BLE nicht verbunden, Aktion ignoriert");
+      return;
     }
+    // Nicht nachholbare Aktion (ttl 0) darf die gepufferten nicht überholen
+    debugPrintln("[DEBUG] Nachholen läuft noch, Aktion verworfen");
+    return;
+  }
+  if (!actionTable.dispatch(action, actionQueue, macros, touchGestures, millis())) {
+    debugPrintln("[DEBUG] Action-Queue oder Makroplätze voll, Aktion verworfen");
+  }
+}
 
-  unsigned long now = millis();
-  // Bluetooth LED Status blinken
-  bool bleConnected = bleCombo.isConnected();
-  if (bleLedPin >= 0 && bleLedPin <= 39) {
-    auto ledWrite = [&](bool on) {
-      digitalWrite(bleLedPin, bleLedInvert ? !on : on);
-    };
-    if (bleConnected) {
-      ledWrite(true); // LED dauerhaft an bei Verbindung
-      bleWasConnected = true;
-      bleFastBlinkActive = false;
+// Gepufferte Aktionen nach dem Wiederverbinden der Reihe nach senden; abgelaufene werden übersprungen.
+// Zwischen zwei Aktionen liegt deren Haltedauer plus eine kurze Pause, damit jede ein eigener Anschlag bleibt.
+void onReplayTimer(void* arg) {
+  if (!bleCombo.isConnected()) {
+    return; // beim nächsten Verbinden geht es weiter
+  }
+  uint32_t now = millis();
+  int16_t action = actionReplay.next(now);
+  if (action == ACTION_NONE) {
+    return;
+  }
+  debugPrint("[DEBUG] Nachgeholt: ");
+  debugPrintln(actionTable.name(action));
+  if (!actionTable.dispatch(action, actionQueue, macros, touchGestures, now)) {
+    debugPrintln("[DEBUG] Action-Queue oder Makroplätze voll, Aktion verworfen");
+  }
+  if (actionReplay.pending() > 0) {
+    scheduler.armIn(replayTimer, actionTable.get(action).hold + REPLAY_GAP_MS);
+  }
+}
+
+// Gesammelte Rastungen abholen, pro Intervall höchstens eine Aktion senden
+void onEncoderTimer(void* arg) {
+  int e = (int)(intptr_t)arg;
+  int32_t pending = encoderPending[e] + encoderInputs[e].readDetents();
+  if (pending > ENCODER_MAX_BACKLOG) {
+    pending = ENCODER_MAX_BACKLOG;
+  } else if (pending < -ENCODER_MAX_BACKLOG) {
+    pending = -ENCODER_MAX_BACKLOG;
+  }
+  if (pending > 0) {
+    pending--;
+    Serial.print("-> Drehgeber rechts");
+    runAction(encoders[e].action_cw);
+  } else if (pending < 0) {
+    pending++;
+    Serial.print("-> Drehgeber links");
+    runAction(encoders[e].action_ccw);
+  }
+  encoderPending[e] = pending;
+}
+
+// Von der Gesten-Engine entschiedene Geste ausführen
+void onGesture(uint8_t button, int16_t action, uint8_t taps, bool hold, bool repeat) {
+  if (repeat) {
+    // Wiederholung beim Halten: ohne Ausgabe, jede Wiederholung ist ein eigener Anschlag
+    if (bleCombo.isConnected() && !actionTable.dispatch(action, actionQueue, macros, touchGestures, millis())) {
+      debugPrintln("[DEBUG] Action-Queue voll, Wiederholung verworfen");
+    }
+    return;
+  }
+  Serial.print("-> ");
+  if (hold && taps == 0) {
+    Serial.print("Langklick");
+  } else if (hold) {
+    Serial.print(taps);
+    Serial.print("x Tippen + Halten");
+  } else if (taps == 1) {
+    Serial.print("Normalklick");
+  } else if (taps == 2) {
+    Serial.print("Doppelklick");
+  } else {
+    Serial.print(taps);
+    Serial.print("-fach Klick");
+  }
+  runAction(action);
+}
+
+// Nächste Deadline eines Buttons (Geste oder Entprellung) im Scheduler eintragen
+void scheduleButton(int i) {
+  unsigned long deadline = 0;
+  unsigned long d;
+  bool armed = gestures.nextDeadline(i, deadline);
+  if (btn.debounce.nextDeadline(i, d) && (!armed || (long)(d - deadline) < 0)) {
+    deadline = d;
+    armed = true;
+  }
+  if (armed) {
+    scheduler.arm(buttonTimers[i], deadline);
+  } else {
+    scheduler.stop(buttonTimers[i]);
+  }
+}
+
+// Gedrückte Richtungen in den Hat-Wert 0..7 (im Uhrzeigersinn ab oben) umrechnen, Gegenrichtungen heben sich auf
+uint8_t hatValue(uint8_t pressed) {
+  if ((pressed & (HAT_UP | HAT_DOWN)) == (HAT_UP | HAT_DOWN)) pressed &= ~(HAT_UP | HAT_DOWN);
+  if ((pressed & (HAT_LEFT | HAT_RIGHT)) == (HAT_LEFT | HAT_RIGHT)) pressed &= ~(HAT_LEFT | HAT_RIGHT);
+  switch (pressed) {
+    case HAT_UP: return 0;
+    case HAT_UP | HAT_RIGHT: return 1;
+    case HAT_RIGHT: return 2;
+    case HAT_DOWN | HAT_RIGHT: return 3;
+    case HAT_DOWN: return 4;
+    case HAT_DOWN | HAT_LEFT: return 5;
+    case HAT_LEFT: return 6;
+    case HAT_UP | HAT_LEFT: return 7;
+  }
+  return GAMEPAD_HAT_CENTER;
+}
+
+// Gamepad-Button: Pegel direkt als Bit senden, ohne Gesten und ohne Drücken/Loslassen-Paar
+void applyGamepadLevel(int i, bool pressed) {
+  if (buttons[i].hatDirection != 0) {
+    if (pressed) {
+      hatPressed |= buttons[i].hatDirection;
     } else {
-      if (bleWasConnected) {
-        bleDisconnectTime = now;
-        bleFastBlinkActive = true;
-        bleWasConnected = false;
+      hatPressed &= ~buttons[i].hatDirection;
+    }
+    bleCombo.setGamepadHat(hatValue(hatPressed));
+  } else {
+    bleCombo.setGamepadButton(buttons[i].gamepadButton - 1, pressed);
+  }
+}
+
+// Entprellten Pegel an die Gesten-Engine weitergeben
+void applyButtonLevel(int i, unsigned long t) {
+  if (buttons[i].gamepadButton != 0 || buttons[i].hatDirection != 0) {
+    applyGamepadLevel(i, btn.debounce.level(i) == LOW);
+    return;
+  }
+  if (btn.debounce.level(i) == LOW) {
+    gestures.press(i, t);
+  } else {
+    gestures.release(i, t);
+  }
+}
+
+// Entprellung und Gesten eines Buttons bis zum Zeitpunkt now weiterschalten
+void tickButton(int i, unsigned long now) {
+  if (btn.debounce.tick(i, now)) {
+    applyButtonLevel(i, now);
+  }
+  gestures.tick(i, now);
+  scheduleButton(i);
+}
+
+void onButtonTimer(void* arg) {
+  tickButton((int)(intptr_t)arg, lastButtonTick);
+}
+
+// Rohe Flanke eines Buttons verarbeiten, Zeitabläufe werden bis zum Flankenzeitpunkt nachgeholt
+void handleEdge(int i, uint8_t level, unsigned long t) {
+  if ((long)(t - lastButtonTick) < 0) {
+    t = lastButtonTick;
+  }
+  tickButton(i, t);
+  if (btn.debounce.edge(i, level, t)) {
+    applyButtonLevel(i, t);
+  }
+  scheduleButton(i);
+}
+
+// Alle Expander-Pins mit einem Bus-Zugriff lesen und geänderte Pins als Flanken weitergeben
+void serviceExpander(unsigned long t) {
+  uint16_t changed;
+  if (!expander.read(changed)) {
+    return;
+  }
+  uint16_t levels = expander.level();
+  while (changed) {
+    int k = __builtin_ctz(changed);
+    changed &= changed - 1;
+    if (expanderToButton[k] >= 0) {
+      handleEdge(expanderToButton[k], (levels >> k) & 0x1, t);
+    }
+  }
+}
+
+void onExpanderPoll(void* arg) {
+  serviceExpander(lastButtonTick);
+}
+
+// Eine ADC-Messung pro Millisekunde; Tastenwechsel als Loslassen der alten und Drücken der neuen Taste
+void onLadderSample(void* arg) {
+  int8_t previous = ladder.pressedKey();
+  int8_t key;
+  if (!ladder.sample(key)) {
+    return;
+  }
+  if (previous != LADDER_NONE && ladderToButton[previous] >= 0) {
+    handleEdge(ladderToButton[previous], HIGH, lastButtonTick);
+  }
+  if (key != LADDER_NONE && ladderToButton[key] >= 0) {
+    handleEdge(ladderToButton[key], LOW, lastButtonTick);
+  }
+}
+
+// Flanken aus der ISR-Queue verarbeiten
+void processInputEvents() {
+  InputEvent ev;
+  // Mehrere INT-Flanken seit dem letzten Durchlauf werden zu einem Bus-Zugriff zusammengefasst
+  bool expanderPending = false;
+  unsigned long expanderTime = 0;
+  while (gpioInput.poll(ev)) {
+    if (ev.pin > GPIO_INPUT_MAX_PIN) {
+      continue;
+    }
+    if (expander.isInterruptPin(ev.pin)) {
+      if (!expanderPending) {
+        expanderPending = true;
+        expanderTime = (unsigned long)(ev.timeUs / 1000);
       }
-      // blinke für 5 secunden nach einem Disconnect schnell, danach wieder langsam
-      if (bleFastBlinkActive && (now - bleDisconnectTime < 5000)) {
-        if (now - bleLedLastToggle > 100) { // schnell blinken (10Hz)
-          bleLedState = !bleLedState;
-          ledWrite(bleLedState);
-          bleLedLastToggle = now;
-        }
-      } else {
-        bleFastBlinkActive = false;
-        if (now - bleLedLastToggle > 500) { // langsam blinken (1Hz) wenn nicht verbunden 
-          bleLedState = !bleLedState;
-          ledWrite(bleLedState);
-          bleLedLastToggle = now;
-        }
+      continue;
+    }
+    if (pinToButton[ev.pin] < 0) {
+      // Spalte der Matrix im Leerlauf: Scan mit voller Rate starten
+      if (matrix.isIdle() && matrix.isColumn(ev.pin)) {
+        wakeMatrix();
       }
+      continue;
     }
+    handleEdge(pinToButton[ev.pin], ev.level, (unsigned long)(ev.timeUs / 1000));
   }
-  for (int i = 0; i < buttonCount; i++) {
-    int pinState = digitalRead(buttons[i].pin);
-    switch (buttons[i].state) {
-        case BTN_IDLE:
-          if (pinState == LOW) {
-            buttons[i].state = BTN_DEBOUNCE;
-            buttons[i].lastChange = now;
-          }
-          break;
-        case BTN_DEBOUNCE:
-          if (pinState == LOW && (now - buttons[i].lastChange > buttons[i].debounce)) {
-            buttons[i].state = BTN_PRESSED;
-            buttons[i].pressStart = now;
-          } else if (pinState == HIGH) {
-            buttons[i].state = BTN_IDLE;
-          }
-          break;
-        case BTN_PRESSED:
-          if (pinState == HIGH) {
-            // Button wurde kurz gedrückt
-            if (buttons[i].doubleClickPending && (now - buttons[i].lastRelease < doubleClickTime)) {
-              // Doppelklick erkannt
-              debugPrint("-> Doppelklick: ");
-              debugPrintln(buttons[i].key_double);
-              String doubleName = buttons[i].key_double;
-              bool mouseDone = false;
-              for (int m = 0; m < mouseActionCount; m++) {
-                if (mouseActions[m].name == doubleName) {
-                  executeMouseAction(doubleName);
-                  mouseDone = true;
-                  break;
-                }
-              }
-              if (!mouseDone && bleConnected) {
-                Serial.print("Keyboard double key: ");
-                Serial.println(buttons[i].key_double);
-                bleCombo.press((uint8_t)buttons[i].key_double[0]);
-                delay(100);
-                bleCombo.release((uint8_t)buttons[i].key_double[0]);
-              }
-              buttons[i].doubleClickPending = false;
-              buttons[i].state = BTN_IDLE;
-            } else {
-              // Warte auf zweiten Klick
-              buttons[i].doubleClickPending = true;
-              buttons[i].lastRelease = now;
-              buttons[i].state = BTN_WAIT_DOUBLE;
-            }
-          } else if (now - buttons[i].pressStart > longPressTime) {
-            // Langklick erkannt
-            Serial.print("-> Langklick: ");
-            Serial.println(buttons[i].key_long);
-            String longName = buttons[i].key_long;
-            bool mouseDone = false;
-            for (int m = 0; m < mouseActionCount; m++) {
-              if (mouseActions[m].name == longName) {
-                executeMouseAction(longName);
-                mouseDone = true;
-                break;
-              }
-            }
-            if (!mouseDone && bleConnected) {
-              Serial.print("[DEBUG] Keyboard long key: ");
-              Serial.println(buttons[i].key_long);
-              bleCombo.press((uint8_t)buttons[i].key_long[0]);
-              delay(100);
-              bleCombo.release((uint8_t)buttons[i].key_long[0]);
-            }
-            buttons[i].doubleClickPending = false;
-            buttons[i].state = BTN_LONG;
-          }
-          break;
-        case BTN_WAIT_DOUBLE:
-          if (pinState == LOW) {
-            buttons[i].state = BTN_DEBOUNCE;
-            buttons[i].lastChange = now;
-          } else if (now - buttons[i].lastRelease > doubleClickTime) {
-            // Zeit abgelaufen, Normalklick
-            Serial.print("-> Normalklick: ");
-            Serial.println(buttons[i].key_normal);
-            String normalName = buttons[i].key_normal;
-            bool mouseDone = false;
-            for (int m = 0; m < mouseActionCount; m++) {
-              if (mouseActions[m].name == normalName) {
-                executeMouseAction(normalName);
-                mouseDone = true;
-                break;
-              }
-            }
-            if (!mouseDone && bleConnected) {
-              Serial.print("Keyboard normal key: ");
-              Serial.println(buttons[i].key_normal);
-              bleCombo.press((uint8_t)buttons[i].key_normal[0]);
-              delay(100);
-              bleCombo.release((uint8_t)buttons[i].key_normal[0]);
-            }
-            buttons[i].doubleClickPending = false;
-            buttons[i].state = BTN_IDLE;
-          }
-          break;
-        case BTN_LONG:
-          if (pinState == HIGH) {
-            buttons[i].state = BTN_IDLE;
-          }
-          break;
-        default:
-          buttons[i].state = BTN_IDLE;
-          break;
+  // Queue übergelaufen: Pegel einmalig direkt aus dem Register nachziehen
+  uint32_t dropped = gpioInput.droppedEvents();
+  if (dropped != lastDroppedEvents) {
+    debugPrint("[DEBUG] Input-Queue übergelaufen, verworfene Flanken: ");
+    debugPrintln(dropped - lastDroppedEvents);
+    lastDroppedEvents = dropped;
+    unsigned long t = millis();
+    for (int i = 0; i < buttonCount; i++) {
+      if (buttons[i].source == BUTTON_SOURCE_GPIO && pinToButton[buttons[i].pin] == i) {
+        uint8_t level = (uint8_t)GpioInput::readLevel(buttons[i].pin);
+        if (level != btn.debounce.rawLevel(i)) {
+          handleEdge(i, level, t);
+        }
       }
-    buttons[i].lastState = pinState;
+    }
+    if (expander.interruptPending() && !expanderPending) {
+      expanderPending = true;
+      expanderTime = t;
+    }
   }
+  if (expanderPending) {
+    serviceExpander(expanderTime);
+  }
+}
 
-  if (batteryEnabled && batteryPin >= 0) {
-    if (now - batteryLastRead > BATTERY_READ_INTERVAL) {
-      batteryLastRead = now;
-      updateBatteryLevel(false);
+// Bit-paralleler Scan: ein Registerzugriff für alle Pins, nur geänderte Bits werden verarbeitet
+void scanInputs(unsigned long now) {
+  uint64_t levels;
+  uint64_t changed = gpioInput.scan(levels);
+  while (changed) {
+    int pin = __builtin_ctzll(changed);
+    changed &= changed - 1;
+    handleEdge(pinToButton[pin], (uint8_t)((levels >> pin) & 0x1), now);
+  }
+}
+
+// Matrix nach einer Flanke im Leerlauf wieder mit voller Rate scannen
+void wakeMatrix() {
+  matrix.leaveIdle();
+  matrixLastActivity = lastButtonTick;
+  scheduler.arm(matrixTimer, lastButtonTick, MATRIX_SCAN_INTERVAL_MS);
+}
+
+// Matrix-Scan: geänderte Tasten als Flanken weitergeben, nach Inaktivität in den Interrupt-Leerlauf
+void onMatrixScan(void* arg) {
+  uint64_t pressed;
+  uint64_t changed = matrix.scan(pressed);
+  if (changed != 0 || pressed != 0) {
+    matrixLastActivity = lastButtonTick;
+  }
+  while (changed) {
+    int k = __builtin_ctzll(changed);
+    changed &= changed - 1;
+    if (matrixToButton[k] >= 0) {
+      handleEdge(matrixToButton[k], ((pressed >> k) & 0x1) ? LOW : HIGH, lastButtonTick);
     }
   }
+  if (pressed == 0 && lastButtonTick - matrixLastActivity > matrixIdleTimeout && matrix.enterIdle()) {
+    scheduler.stop(matrixTimer);
+  }
+}
+
+bool bleLedState = false;
+bool bleLedStarted = false;
+bool bleWasConnected = false;
+TimerId bleLedBlinkTimer = SCHEDULER_NO_TIMER;
+TimerId bleLedFastTimer = SCHEDULER_NO_TIMER;
+
+void bleLedWrite(bool on) {
+  digitalWrite(bleLedPin, bleLedInvert ? !on : on);
+}
+
+void onBleLedBlink(void* arg) {
+  bleLedState = !bleLedState;
+  bleLedWrite(bleLedState);
+}
+
+// 5 Sekunden nach einem Disconnect vorbei: wieder langsam blinken (1Hz)
+void onBleLedFastEnd(void* arg) {
+  scheduler.armIn(bleLedBlinkTimer, 500, 500);
+}
+
+// Bluetooth LED bei Verbindungswechsel umstellen, das Blinken läuft über den Scheduler
+void updateBleLed(bool connected) {
+  if (bleLedPin < 0 || bleLedPin > 39) {
+    return;
+  }
+  if (!bleLedStarted) {
+    bleLedBlinkTimer = scheduler.create(onBleLedBlink);
+    bleLedFastTimer = scheduler.create(onBleLedFastEnd);
+    bleLedStarted = true;
+  }
+  if (connected) {
+    scheduler.stop(bleLedBlinkTimer);
+    scheduler.stop(bleLedFastTimer);
+    bleLedWrite(true); // LED dauerhaft an bei Verbindung
+  } else if (bleWasConnected) {
+    // blinke für 5 secunden nach einem Disconnect schnell (10Hz), danach wieder langsam
+    scheduler.armIn(bleLedBlinkTimer, 100, 100);
+    scheduler.armIn(bleLedFastTimer, 5000);
+  } else {
+    scheduler.armIn(bleLedBlinkTimer, 500, 500); // langsam blinken (1Hz) wenn nicht verbunden
+  }
+}
+
+void loop() {
+  if (webserverActive) {
+    server.handleClient();
+  }
+
+  bool bleConnected = bleCombo.isConnected();
+  if (bleConnected != bleWasConnected || !bleLedStarted) {
+    updateBleLed(bleConnected);
+    if (bleConnected && actionReplay.pending() > 0) {
+      scheduler.armIn(replayTimer, replayDelay);
+    }
+    bleWasConnected = bleConnected;
+  }
+  // Vom Host tatsächlich gewählte Verbindungsparameter ausgeben, nach dem Verbinden und bei jeder Änderung
+  const LinkStats& link = bleCombo.getLinkStats();
+  if (link.updates != lastLinkUpdates) {
+    lastLinkUpdates = link.updates;
+    Serial.print("BLE-Verbindung: Intervall ");
+    Serial.print((unsigned long)link.intervalUs);
+    Serial.print(" us, Latenz ");
+    Serial.print((unsigned long)link.latency);
+    Serial.print(", Timeout ");
+    Serial.print((unsigned long)link.timeoutMs);
+    Serial.println(" ms");
+  }
+
+  if (inputMode == INPUT_MODE_SCAN) {
+    scanInputs(millis());
+  }
+  // Im Scan-Modus kommen hier nur noch Weckflanken der Matrix an
+  processInputEvents();
+  // Alle fälligen Deadlines (Gesten, Entprellung, LED, Battery, Webserver) abarbeiten
+  unsigned long now = millis();
+  lastButtonTick = now;
+  scheduler.run(now);
+  // Änderungen dieses Durchlaufs zu je einem Report zusammenfassen und senden, sobald der Controller sie annimmt
+  bleCombo.update();
+
+  // CPU bis zur nächsten Flanke, zum nächsten Scan oder zur nächsten Deadline schlafen lassen
+  uint32_t maxWait = MAX_IDLE_WAIT_MS;
+  if (inputMode == INPUT_MODE_SCAN) {
+    maxWait = SCAN_INTERVAL_MS;
+  } else if (webserverActive) {
+    maxWait = IDLE_WAIT_MS;
+  }
+  uint32_t reportWait = bleCombo.msUntilReady();
+  if (reportWait < maxWait) {
+    maxWait = reportWait;
+  }
+  gpioInput.waitForEvent(scheduler.msUntilNext(millis(), maxWait));
 }
-  
\ No newline at end of file
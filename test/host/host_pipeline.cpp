@@ -0,0 +1,115 @@
+#include "host_pipeline.h"
+#include "KeyExpression.h"
+#include "host_clock.h"
+#include <esp_timer.h>
+
+static HostPipeline* instance = nullptr;
+
+HostPipeline::HostPipeline(FILE* out)
+    : loopback(out)
+{
+  instance = this;
+  loopback.setClock(esp_timer_get_time);
+  combo.setTransport(&loopback);
+  combo.begin();
+  for (uint8_t i = 0; i < HOST_PIPELINE_BUTTONS; i++) {
+    buttonTimers[i] = scheduler.create(onButtonTimer, (void*)(intptr_t)i);
+    debounce.init(i, DEBOUNCE_DELAY, 5, HIGH);
+    gestures.clear(i);
+  }
+  actionQueue.begin(&combo, &scheduler);
+  macros.begin(&combo, &scheduler);
+  touchGestures.begin(&combo, &scheduler);
+  gestures.setCallback(onGesture);
+}
+
+HostPipeline::~HostPipeline()
+{
+  combo.end();
+  instance = nullptr;
+}
+
+// Button with a 5 ms delay debounce, 200 ms tap term and 300 ms hold term
+void HostPipeline::bindButton(uint8_t i, int16_t tap, int16_t doubleTap, int16_t hold)
+{
+  gestures.clear(i);
+  gestures.bindTap(i, 1, tap);
+  gestures.bindTap(i, 2, doubleTap);
+  gestures.bindHold(i, 0, hold);
+  gestures.compile(i, 200, 300, HOLD_TIMEOUT);
+}
+
+int16_t HostPipeline::addKey(const char* expression, uint16_t holdMs)
+{
+  KeyReport report;
+  if (!KeyExpression::compile(expression, report)) {
+    return ACTION_NONE;
+  }
+  return actions.addKey(expression, report, holdMs, ReplayPolicy{0, false});
+}
+
+void HostPipeline::scheduleButton(uint8_t i)
+{
+  unsigned long deadline = 0;
+  unsigned long d;
+  bool armed = gestures.nextDeadline(i, deadline);
+  if (debounce.nextDeadline(i, d) && (!armed || (long)(d - deadline) < 0)) {
+    deadline = d;
+    armed = true;
+  }
+  if (armed) {
+    scheduler.arm(buttonTimers[i], deadline);
+  } else {
+    scheduler.stop(buttonTimers[i]);
+  }
+}
+
+void HostPipeline::applyLevel(uint8_t i, unsigned long now)
+{
+  if (debounce.level(i) == LOW) {
+    gestures.press(i, now);
+  } else {
+    gestures.release(i, now);
+  }
+}
+
+void HostPipeline::onButtonTimer(void* arg)
+{
+  uint8_t i = (uint8_t)(intptr_t)arg;
+  if (instance->debounce.tick(i, instance->loopNow)) {
+    instance->applyLevel(i, instance->loopNow);
+  }
+  instance->gestures.tick(i, instance->loopNow);
+  instance->scheduleButton(i);
+}
+
+void HostPipeline::onGesture(uint8_t button, int16_t action, uint8_t taps, bool hold, bool repeat)
+{
+  (void)button;
+  (void)taps;
+  (void)hold;
+  (void)repeat;
+  instance->actions.dispatch(action, instance->actionQueue, instance->macros, instance->touchGestures, millis());
+}
+
+// Raw level of a button at the current time, like the GPIO edge path in main.cpp
+void HostPipeline::edge(uint8_t i, uint8_t level)
+{
+  unsigned long now = millis();
+  if (debounce.edge(i, level, now)) {
+    applyLevel(i, now);
+  }
+  scheduleButton(i);
+}
+
+// One loop() pass per millisecond up to the given millis() value: timers first,
+// then one report per tick
+void HostPipeline::runUntil(unsigned long until)
+{
+  while ((long)(until - millis()) > 0) {
+    hostClockAdvance(1000);
+    loopNow = millis();
+    scheduler.run(loopNow);
+    combo.update();
+  }
+}
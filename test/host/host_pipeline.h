@@ -0,0 +1,52 @@
+#ifndef HOST_PIPELINE_H
+#define HOST_PIPELINE_H
+
+#include "ActionQueue.h"
+#include "ActionTable.h"
+#include "BleComboAbs.h"
+#include "Debounce.h"
+#include "Gesture.h"
+#include "LoopbackTransport.h"
+#include "MacroEngine.h"
+#include "Scheduler.h"
+#include "TouchGestures.h"
+#include <stdio.h>
+
+#define HOST_PIPELINE_BUTTONS 8
+
+// The input path of main.cpp for host builds: raw edges through debounce and
+// the gesture engine to the action table, action queue, macros and touch
+// gestures, reported by BleComboAbs over a LoopbackTransport. Time is the host
+// clock (host_clock.h); runUntil() makes one loop() pass per millisecond.
+// Only one instance can exist, the gesture callback has no context argument.
+class HostPipeline
+{
+private:
+  LoopbackTransport loopback;
+  TimerId buttonTimers[HOST_PIPELINE_BUTTONS];
+  unsigned long loopNow = 0;
+
+  void scheduleButton(uint8_t i);
+  void applyLevel(uint8_t i, unsigned long now);
+  static void onButtonTimer(void* arg);
+  static void onGesture(uint8_t button, int16_t action, uint8_t taps, bool hold, bool repeat);
+
+public:
+  BleComboAbs combo;
+  Scheduler scheduler;
+  Debounce debounce;
+  GestureEngine gestures;
+  ActionTable actions;
+  ActionQueue actionQueue;
+  MacroEngine macros;
+  TouchGestures touchGestures;
+
+  explicit HostPipeline(FILE* out);
+  ~HostPipeline();
+  void bindButton(uint8_t i, int16_t tap, int16_t doubleTap, int16_t hold);
+  int16_t addKey(const char* expression, uint16_t holdMs);
+  void edge(uint8_t i, uint8_t level);
+  void runUntil(unsigned long until);
+};
+
+#endif // HOST_PIPELINE_H
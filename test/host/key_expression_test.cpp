@@ -0,0 +1,47 @@
+#include "KeyExpression.h"
+#include <stdio.h>
+
+// Compiled reports of config key expressions, and expressions that must be rejected
+
+static int failures = 0;
+
+static void expectReport(const char* expression, uint8_t modifiers, uint8_t key0, uint8_t key1)
+{
+  KeyReport report;
+  bool compiled = KeyExpression::compile(expression, report);
+  bool ok = compiled && report.modifiers == modifiers && report.keys[0] == key0 && report.keys[1] == key1 && report.keys[2] == 0;
+  printf("%s %s\n", ok ? "ok  " : "FAIL", expression);
+  if (!ok) {
+    printf("  expected: compiled modifiers=0x%x keys=%u,%u\n", modifiers, key0, key1);
+    printf("  got:      %s modifiers=0x%x keys=%u,%u,%u\n", compiled ? "compiled" : "rejected", report.modifiers, report.keys[0],
+           report.keys[1], report.keys[2]);
+    failures++;
+  }
+}
+
+static void expectRejected(const char* expression)
+{
+  KeyReport report;
+  bool ok = !KeyExpression::compile(expression, report) && KeyExpression::isEmpty(report);
+  printf("%s %s rejected\n", ok ? "ok  " : "FAIL", expression);
+  if (!ok) {
+    failures++;
+  }
+}
+
+int main(void)
+{
+  expectReport("a", 0x00, 0x04, 0);
+  expectReport("A", 0x02, 0x04, 0);
+  expectReport("CTRL+SHIFT+U", 0x03, 0x18, 0);
+  expectReport("F5", 0x00, 0x3E, 0);
+  // '+' is Shift plus the '=' usage
+  expectReport("+", 0x02, 0x2E, 0);
+  expectReport("CTRL++", 0x03, 0x2E, 0);
+  expectReport("CTRL+++A", 0x03, 0x2E, 0x04);
+  expectRejected("CTRL++A");
+  expectRejected("+a");
+  expectRejected("CTRL+NOPE");
+  expectRejected("");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#include "BleComboAbs.h"
+#include "LoopbackTransport.h"
+#include "report_lines.h"
+
+// Link profiles against emulated hosts that grant, clamp or reject the request.
+// Every loopback connection starts at the host's own choice (15 ms, 5 s) and
+// reports that first.
+
+static int failures = 0;
+
+static void expectStats(const char* name, const LinkStats& stats, uint32_t intervalUs, uint32_t latency, uint32_t timeoutMs,
+                        uint32_t updates)
+{
+  bool ok = stats.intervalUs == intervalUs && stats.latency == latency && stats.timeoutMs == timeoutMs && stats.updates == updates;
+  printf("%s %s stats\n", ok ? "ok  " : "FAIL", name);
+  if (!ok) {
+    printf("  expected: interval_us=%u latency=%u timeout_ms=%u updates=%u\n", (unsigned)intervalUs, (unsigned)latency,
+           (unsigned)timeoutMs, (unsigned)updates);
+    printf("  got:      interval_us=%u latency=%u timeout_ms=%u updates=%u\n", (unsigned)stats.intervalUs, (unsigned)stats.latency,
+           (unsigned)stats.timeoutMs, (unsigned)stats.updates);
+    failures++;
+  }
+}
+
+// Connects with the named profile to a host with the given limits and returns the output
+static FILE* connect(const char* profile, uint16_t hostMinInterval, uint16_t hostMaxLatency, LinkStats& stats)
+{
+  FILE* out = tmpfile();
+  LoopbackTransport loopback(out);
+  loopback.setHostLimits(hostMinInterval, hostMaxLatency);
+  BleComboAbs combo;
+  combo.setTransport(&loopback);
+  HidLinkParams params;
+  if (!BleComboAbs::parseLinkProfile(profile, params)) {
+    printf("FAIL unknown profile %s\n", profile);
+    failures++;
+  } else {
+    combo.setLinkProfile(params);
+  }
+  combo.begin();
+  stats = combo.getLinkStats();
+  return out;
+}
+
+static void testRaceAccepted(void)
+{
+  LinkStats stats;
+  FILE* out = connect("race", 6, 499, stats);
+  if (!expectLines("race accepted", out, {
+    "link interval_us=15000 latency=0 timeout_ms=5000",
+    "link interval_us=7500 latency=0 timeout_ms=2000",
+  })) {
+    failures++;
+  }
+  expectStats("race accepted", stats, 7500, 0, 2000, 2);
+  fclose(out);
+}
+
+static void testRaceClamped(void)
+{
+  // 10 ms is the host's shortest interval, still within the race range
+  LinkStats stats;
+  FILE* out = connect("race", 8, 499, stats);
+  if (!expectLines("race clamped", out, {
+    "link interval_us=15000 latency=0 timeout_ms=5000",
+    "link interval_us=10000 latency=0 timeout_ms=2000",
+  })) {
+    failures++;
+  }
+  expectStats("race clamped", stats, 10000, 0, 2000, 2);
+  fclose(out);
+}
+
+static void testRaceRejected(void)
+{
+  // The host's shortest interval (15 ms) lies above the whole race range
+  LinkStats stats;
+  FILE* out = connect("race", 12, 30, stats);
+  if (!expectLines("race rejected", out, {
+    "link interval_us=15000 latency=0 timeout_ms=5000",
+    "link rejected interval=6..9",
+  })) {
+    failures++;
+  }
+  expectStats("race rejected", stats, 15000, 0, 5000, 1);
+  fclose(out);
+}
+
+static void testEnduranceAccepted(void)
+{
+  LinkStats stats;
+  FILE* out = connect("endurance", 6, 499, stats);
+  if (!expectLines("endurance accepted", out, {
+    "link interval_us=15000 latency=0 timeout_ms=5000",
+    "link interval_us=100000 latency=10 timeout_ms=6000",
+  })) {
+    failures++;
+  }
+  expectStats("endurance accepted", stats, 100000, 10, 6000, 2);
+  fclose(out);
+}
+
+static void testEnduranceClamped(void)
+{
+  // The host allows at most 4 skipped events instead of 10
+  LinkStats stats;
+  FILE* out = connect("endurance", 12, 4, stats);
+  if (!expectLines("endurance clamped", out, {
+    "link interval_us=15000 latency=0 timeout_ms=5000",
+    "link interval_us=100000 latency=4 timeout_ms=6000",
+  })) {
+    failures++;
+  }
+  expectStats("endurance clamped", stats, 100000, 4, 6000, 2);
+  fclose(out);
+}
+
+static void testUnknownProfile(void)
+{
+  HidLinkParams params = {1, 2, 3, 4};
+  bool ok = !BleComboAbs::parseLinkProfile("default", params) && params.minInterval == 1;
+  printf("%s unknown profile\n", ok ? "ok  " : "FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+
+int main(void)
+{
+  testRaceAccepted();
+  testRaceClamped();
+  testRaceRejected();
+  testEnduranceAccepted();
+  testEnduranceClamped();
+  testUnknownProfile();
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+#include "BleComboAbs.h"
+#include "LoopbackTransport.h"
+#include "report_lines.h"
+
+// Drives BleComboAbs through LoopbackTransport and checks the decoded report lines
+
+static int failures = 0;
+
+static void testKeyboard(void)
+{
+  FILE* out = tmpfile();
+  LoopbackTransport loopback(out);
+  BleComboAbs combo;
+  combo.setTransport(&loopback);
+  combo.begin();
+
+  combo.press(KEY_LEFT_SHIFT);
+  combo.press('u');
+  combo.update();
+  combo.release('u');
+  combo.update();
+  combo.releaseAll();
+  combo.update();
+
+  if (!expectLines("keyboard", out, {
+    "link interval_us=15000 latency=0 timeout_ms=5000",
+    "id=1 Keyboard 07:e0=0x2 07:00=24,0,0,0,0,0",
+    "id=1 Keyboard 07:e0=0x2 07:00=0,0,0,0,0,0",
+    "id=1 Keyboard 07:e0=0x0 07:00=0,0,0,0,0,0",
+  })) {
+    failures++;
+  }
+  fclose(out);
+}
+
+static void testRepress(void)
+{
+  // Released and pressed again in one tick: the release still gets its own report
+  FILE* out = tmpfile();
+  LoopbackTransport loopback(out);
+  BleComboAbs combo;
+  combo.setTransport(&loopback);
+  combo.begin();
+
+  combo.press('a');
+  combo.update();
+  combo.release('a');
+  combo.press('a');
+  combo.update();
+
+  KeyReport ctrlA = {};
+  ctrlA.modifiers = 0x01;
+  ctrlA.keys[0] = 0x04;
+  combo.releaseReport(ctrlA);
+  combo.pressReport(ctrlA);
+  combo.update();
+
+  if (!expectLines("release and re-press", out, {
+    "link interval_us=15000 latency=0 timeout_ms=5000",
+    "id=1 Keyboard 07:e0=0x0 07:00=4,0,0,0,0,0",
+    "id=1 Keyboard 07:e0=0x0 07:00=0,0,0,0,0,0",
+    "id=1 Keyboard 07:e0=0x0 07:00=4,0,0,0,0,0",
+    "id=1 Keyboard 07:e0=0x0 07:00=0,0,0,0,0,0",
+    "id=1 Keyboard 07:e0=0x1 07:00=4,0,0,0,0,0",
+  })) {
+    failures++;
+  }
+  fclose(out);
+}
+
+static void testPointerGamepadTouch(void)
+{
+  FILE* out = tmpfile();
+  LoopbackTransport loopback(out);
+  BleComboAbs combo;
+  combo.setTransport(&loopback);
+  combo.begin();
+
+  combo.moveAbs(5000, 2500);
+  combo.update();
+  combo.releaseAbs();
+  combo.update();
+  combo.setGamepadButton(3, true);
+  combo.setGamepadHat(2);
+  combo.update();
+  combo.setTouch(0, true, 4000, 5000);
+  combo.setTouch(1, true, 6000, 5000);
+  combo.update();
+  combo.releaseTouch();
+  combo.update();
+
+  if (!expectLines("pointer, gamepad and touch", out, {
+    "link interval_us=15000 latency=0 timeout_ms=5000",
+    "id=2 TouchScreen 0d:42=0x3 01:30=5000,2500",
+    "id=2 TouchScreen 0d:42=0x0 01:30=0,0",
+    "id=4 Gamepad 09:01=0x8 01:39=2",
+    "id=5 TouchScreen 0d:42=0x1 0d:51=0 01:30=4000,5000 0d:42=0x1 0d:51=1 01:30=6000,5000 0d:54=2",
+    "id=5 TouchScreen 0d:42=0x0 0d:51=0 01:30=4000,5000 0d:42=0x0 0d:51=1 01:30=6000,5000 0d:54=2",
+  })) {
+    failures++;
+  }
+  fclose(out);
+}
+
+int main(void)
+{
+  testKeyboard();
+  testRepress();
+  testPointerGamepadTouch();
+  return failures == 0 ? 0 : 1;
+}
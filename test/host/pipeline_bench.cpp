@@ -0,0 +1,69 @@
+#include "host_clock.h"
+#include "host_pipeline.h"
+#include "report_lines.h"
+#include <stdlib.h>
+#include <chrono>
+#include <esp_timer.h>
+
+// Host benchmark of the input path: taps with contact bounce on 8 buttons go
+// through HostPipeline in simulated time. Prints the host CPU time per
+// simulated loop pass and per report, and the latency from the first raw
+// press edge to the press report (debounce plus scheduling, simulated time).
+//
+//   pipeline_bench [taps]
+
+int main(int argc, char** argv)
+{
+  unsigned long taps = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+  hostClockSet(0);
+  FILE* out = tmpfile();
+  std::vector<int64_t> pressedUs;
+  unsigned long loops;
+  auto begin = std::chrono::steady_clock::now();
+  {
+    HostPipeline p(out);
+    static const char* keys[HOST_PIPELINE_BUTTONS] = {"1", "2", "3", "4", "5", "6", "7", "8"};
+    for (uint8_t i = 0; i < HOST_PIPELINE_BUTTONS; i++) {
+      // Only a single tap bound: fires on the debounced press
+      p.bindButton(i, p.addKey(keys[i], 20), ACTION_NONE, ACTION_NONE);
+    }
+    srand(1);
+    unsigned long first = millis();
+    for (unsigned long n = 0; n < taps; n++) {
+      uint8_t b = n % HOST_PIPELINE_BUTTONS;
+      pressedUs.push_back(esp_timer_get_time());
+      p.edge(b, LOW);
+      for (int bounce = rand() % 4; bounce > 0; bounce--) {
+        p.runUntil(millis() + 1);
+        p.edge(b, HIGH);
+        p.edge(b, LOW);
+      }
+      p.runUntil(millis() + 40);
+      p.edge(b, HIGH);
+      p.runUntil(millis() + 10 + rand() % 10);
+    }
+    p.runUntil(millis() + 100);
+    loops = millis() - first;
+  }
+  double hostMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+  // Every tap gives a press and a release report, in order
+  std::vector<std::string> lines = readLines(out, 0);
+  unsigned long reports = lines.size() - 1;
+  int64_t minUs = INT64_MAX;
+  int64_t maxUs = 0;
+  int64_t sumUs = 0;
+  for (unsigned long n = 0; n < taps && 1 + 2 * n < lines.size(); n++) {
+    int64_t latency = strtoll(lines[1 + 2 * n].c_str(), nullptr, 10) - pressedUs[n];
+    minUs = latency < minUs ? latency : minUs;
+    maxUs = latency > maxUs ? latency : maxUs;
+    sumUs += latency;
+  }
+  printf("taps %lu, reports %lu, simulated %lu ms\n", taps, reports, loops);
+  printf("host time %.1f ms: %.3f us per loop pass, %.3f us per report\n", hostMs, hostMs * 1000 / loops,
+         hostMs * 1000 / (reports > 0 ? reports : 1));
+  printf("press edge to report: min %lld us, avg %lld us, max %lld us\n", (long long)minUs,
+         (long long)(taps > 0 ? sumUs / (int64_t)taps : 0), (long long)maxUs);
+  fclose(out);
+  return reports == 2 * taps ? 0 : 1;
+}
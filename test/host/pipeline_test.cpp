@@ -0,0 +1,135 @@
+#include "host_clock.h"
+#include "host_pipeline.h"
+#include "report_lines.h"
+#include <string.h>
+
+// Raw button edges through debounce, gestures, action table and action queue /
+// macro engine to the loopback. The report lines are checked with their time
+// stamps, in microseconds since the start of each test.
+
+static int failures = 0;
+
+// Each test starts a second after the previous one; the clock only moves forward
+static unsigned long startTest(void)
+{
+  hostClockAdvance(1000000);
+  return millis();
+}
+
+static void testBouncyTap(void)
+{
+  unsigned long t = startTest();
+  FILE* out = tmpfile();
+  {
+    HostPipeline p(out);
+    p.bindButton(0, p.addKey("a", 30), p.addKey("b", 30), p.addKey("c", 30));
+    // Press with contact bounce, release with bounce 80 ms later
+    p.edge(0, LOW);
+    p.runUntil(t + 1);
+    p.edge(0, HIGH);
+    p.runUntil(t + 2);
+    p.edge(0, LOW);
+    p.runUntil(t + 80);
+    p.edge(0, HIGH);
+    p.runUntil(t + 81);
+    p.edge(0, LOW);
+    p.runUntil(t + 82);
+    p.edge(0, HIGH);
+    p.runUntil(t + 400);
+  }
+  // Released for good at 87 ms (5 ms stable); the tap is decided once the
+  // 200 ms double tap window has passed
+  if (!expectLines("bouncy tap", out, {
+    "0 link interval_us=15000 latency=0 timeout_ms=5000",
+    "288000 id=1 Keyboard 07:e0=0x0 07:00=4,0,0,0,0,0",
+    "318000 id=1 Keyboard 07:e0=0x0 07:00=0,0,0,0,0,0",
+  }, (int64_t)t * 1000)) {
+    failures++;
+  }
+  fclose(out);
+}
+
+static void testDoubleTapAndHold(void)
+{
+  unsigned long t = startTest();
+  FILE* out = tmpfile();
+  {
+    HostPipeline p(out);
+    p.bindButton(0, p.addKey("a", 30), p.addKey("b", 30), p.addKey("c", 30));
+    p.edge(0, LOW);
+    p.runUntil(t + 50);
+    p.edge(0, HIGH);
+    p.runUntil(t + 100);
+    p.edge(0, LOW);
+    p.runUntil(t + 150);
+    p.edge(0, HIGH);
+    p.runUntil(t + 500);
+    // Held past the hold term
+    p.edge(0, LOW);
+    p.runUntil(t + 900);
+    p.edge(0, HIGH);
+    p.runUntil(t + 1200);
+  }
+  // Nothing is bound beyond two taps, so the second press fires at once (105 ms);
+  // the hold fires 300 ms after the debounced press at 505 ms
+  if (!expectLines("double tap and hold", out, {
+    "0 link interval_us=15000 latency=0 timeout_ms=5000",
+    "105000 id=1 Keyboard 07:e0=0x0 07:00=5,0,0,0,0,0",
+    "135000 id=1 Keyboard 07:e0=0x0 07:00=0,0,0,0,0,0",
+    "806000 id=1 Keyboard 07:e0=0x0 07:00=6,0,0,0,0,0",
+    "836000 id=1 Keyboard 07:e0=0x0 07:00=0,0,0,0,0,0",
+  }, (int64_t)t * 1000)) {
+    failures++;
+  }
+  fclose(out);
+}
+
+static void testTextMacro(void)
+{
+  unsigned long t = startTest();
+  FILE* out = tmpfile();
+  {
+    HostPipeline p(out);
+    // A text step with "gap": 0, only the minimum tap gap separates the letters
+    int8_t macro = p.macros.define("hello", 0);
+    MacroStep step;
+    memset(&step, 0, sizeof(MacroStep));
+    step.type = MACRO_STEP_KEY_TAP;
+    step.ms = 1;
+    for (const char* c = "hello"; *c != '\0'; c++) {
+      memset(&step.report, 0, sizeof(KeyReport));
+      step.report.keys[0] = BleComboAbs::usageFromAscii((uint8_t)*c, &step.report.modifiers);
+      p.macros.addStep(step);
+    }
+    p.bindButton(0, p.actions.addMacro("hello", macro, ReplayPolicy{0, false}), ACTION_NONE, ACTION_NONE);
+    p.edge(0, LOW);
+    p.runUntil(t + 20);
+    p.edge(0, HIGH);
+    p.runUntil(t + 100);
+  }
+  if (!expectLines("text macro", out, {
+    "0 link interval_us=15000 latency=0 timeout_ms=5000",
+    "5000 id=1 Keyboard 07:e0=0x0 07:00=11,0,0,0,0,0",
+    "6000 id=1 Keyboard 07:e0=0x0 07:00=0,0,0,0,0,0",
+    "7000 id=1 Keyboard 07:e0=0x0 07:00=8,0,0,0,0,0",
+    "8000 id=1 Keyboard 07:e0=0x0 07:00=0,0,0,0,0,0",
+    "9000 id=1 Keyboard 07:e0=0x0 07:00=15,0,0,0,0,0",
+    "10000 id=1 Keyboard 07:e0=0x0 07:00=0,0,0,0,0,0",
+    "11000 id=1 Keyboard 07:e0=0x0 07:00=15,0,0,0,0,0",
+    "12000 id=1 Keyboard 07:e0=0x0 07:00=0,0,0,0,0,0",
+    "13000 id=1 Keyboard 07:e0=0x0 07:00=18,0,0,0,0,0",
+    "14000 id=1 Keyboard 07:e0=0x0 07:00=0,0,0,0,0,0",
+  }, (int64_t)t * 1000)) {
+    failures++;
+  }
+  fclose(out);
+}
+
+int main(void)
+{
+  hostClockSet(0);
+  testBouncyTap();
+  testDoubleTapAndHold();
+  testTextMacro();
+  return failures == 0 ? 0 : 1;
+}
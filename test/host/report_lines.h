@@ -0,0 +1,49 @@
+#ifndef REPORT_LINES_H
+#define REPORT_LINES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define LINES_WITHOUT_TIME -1
+
+// Lines LoopbackTransport wrote to f. The timestamp in front of each is dropped,
+// or with a time base given, rewritten as microseconds since that base.
+inline std::vector<std::string> readLines(FILE* f, int64_t base = LINES_WITHOUT_TIME)
+{
+  std::vector<std::string> lines;
+  char line[256];
+  rewind(f);
+  while (fgets(line, sizeof(line), f) != nullptr) {
+    line[strcspn(line, "\n")] = '\0';
+    char* text = strchr(line, ' ');
+    if (text == nullptr) {
+      lines.push_back(line);
+    } else if (base == LINES_WITHOUT_TIME) {
+      lines.push_back(text + 1);
+    } else {
+      lines.push_back(std::to_string(strtoll(line, nullptr, 10) - base) + text);
+    }
+  }
+  return lines;
+}
+
+inline bool expectLines(const char* name, FILE* f, const std::vector<std::string>& expected, int64_t base = LINES_WITHOUT_TIME)
+{
+  std::vector<std::string> lines = readLines(f, base);
+  bool ok = lines == expected;
+  printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+  if (!ok) {
+    for (const std::string& l : expected) {
+      printf("  expected: %s\n", l.c_str());
+    }
+    for (const std::string& l : lines) {
+      printf("  got:      %s\n", l.c_str());
+    }
+  }
+  return ok;
+}
+
+#endif // REPORT_LINES_H
@@ -0,0 +1,71 @@
+#include "Arduino.h"
+#include "esp_timer.h"
+#include "host_clock.h"
+#include <stdio.h>
+#include <chrono>
+
+HardwareSerial Serial;
+
+static bool clockSet = false;
+static int64_t clockUs = 0;
+
+void hostClockSet(int64_t us)
+{
+  clockUs = us;
+  clockSet = true;
+}
+
+void hostClockAdvance(int64_t us)
+{
+  clockUs += us;
+}
+
+int64_t esp_timer_get_time(void)
+{
+  if (clockSet) {
+    return clockUs;
+  }
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned long millis(void)
+{
+  return (unsigned long)(esp_timer_get_time() / 1000);
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+  size_t n = 0;
+  while (size-- > 0) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(const char* s)
+{
+  return write((const uint8_t*)s, strlen(s));
+}
+
+size_t Print::print(const String& s)
+{
+  return print(s.c_str());
+}
+
+size_t Print::print(long long value)
+{
+  char buffer[24];
+  snprintf(buffer, sizeof(buffer), "%lld", value);
+  return print(buffer);
+}
+
+size_t Print::println(void)
+{
+  return write('\n');
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  return fputc(c, stderr) == EOF ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "WString.h"
+#include "Print.h"
+
+#define HIGH 1
+#define LOW 0
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis(void);
+
+// Serial output goes to stderr, so the decoded reports on stdout stay clean
+class HardwareSerial : public Print
+{
+public:
+  size_t write(uint8_t c) override;
+};
+
+extern HardwareSerial Serial;
+
+#endif // ARDUINO_H
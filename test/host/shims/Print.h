@@ -0,0 +1,42 @@
+#ifndef PRINT_H
+#define PRINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "WString.h"
+
+// The part of Arduino's Print the firmware modules use; numbers are printed in decimal
+class Print
+{
+private:
+  int writeError = 0;
+
+protected:
+  void setWriteError(int error = 1)
+  {
+    writeError = error;
+  }
+
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+
+  size_t print(const char* s);
+  size_t print(const String& s);
+  size_t print(long long value);
+  template <typename T>
+  size_t print(T value)
+  {
+    return print((long long)value);
+  }
+  size_t println(void);
+  template <typename T>
+  size_t println(T value)
+  {
+    size_t n = print(value);
+    return n + println();
+  }
+};
+
+#endif // PRINT_H
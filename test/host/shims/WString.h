@@ -0,0 +1,22 @@
+#ifndef WSTRING_H
+#define WSTRING_H
+
+#include <string>
+
+// Arduino's String, as far as the firmware modules use it
+class String
+{
+private:
+  std::string text;
+
+public:
+  String(const char* s = "") : text(s != nullptr ? s : "") {}
+  unsigned int length(void) const { return text.size(); }
+  const char* c_str(void) const { return text.c_str(); }
+  char operator[](unsigned int i) const { return text[i]; }
+  bool operator==(const String& other) const { return text == other.text; }
+  bool operator==(const char* other) const { return text == other; }
+  bool operator!=(const String& other) const { return text != other.text; }
+};
+
+#endif // WSTRING_H
@@ -0,0 +1,11 @@
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+#include <stdint.h>
+
+// Time behind millis() and esp_timer_get_time() in the host build: the steady
+// clock, until a test sets it. From then on it only moves when the test says so.
+void hostClockSet(int64_t us);
+void hostClockAdvance(int64_t us);
+
+#endif // HOST_CLOCK_H
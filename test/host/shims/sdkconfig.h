@@ -0,0 +1,7 @@
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+// Host build: CONFIG_BT_ENABLED stays undefined, so BleComboAbs is built
+// without NimBLE and only talks to the transport it is given
+
+#endif // SDKCONFIG_H